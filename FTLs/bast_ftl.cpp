@@ -37,6 +37,7 @@
 #include <math.h>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include "../ssd.h"
 
 using namespace ssd;
@@ -53,6 +54,7 @@ LogPageBlock::LogPageBlock()
 	}
 
 	numPages = 0;
+	index = 0;
 
 	next = NULL;
 }
@@ -87,6 +89,13 @@ FtlImpl_Bast::FtlImpl_Bast(Controller &controller):
 	for (uint i=0;i<NUMBER_OF_ADDRESSABLE_BLOCKS;i++)
 		data_list[i] = -1;
 
+	// Initialise log block lookup.
+	log_map = new LogPageBlock*[NUMBER_OF_ADDRESSABLE_BLOCKS];
+	std::fill_n(log_map, NUMBER_OF_ADDRESSABLE_BLOCKS, (LogPageBlock*) NULL);
+
+	log_lbns = new long[BAST_LOG_PAGE_LIMIT];
+	log_count = 0;
+
 	printf("Total mapping table size: %luKB\n", NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(uint) / 1024);
 	printf("Using BAST FTL.\n");
 }
@@ -94,6 +103,11 @@ FtlImpl_Bast::FtlImpl_Bast(Controller &controller):
 FtlImpl_Bast::~FtlImpl_Bast(void)
 {
 	delete data_list;
+
+	for (uint i=0;i<log_count;i++)
+		delete log_map[log_lbns[i]];
+	delete[] log_map;
+	delete[] log_lbns;
 }
 
 enum status FtlImpl_Bast::read(Event &event)
@@ -102,9 +116,7 @@ enum status FtlImpl_Bast::read(Event &event)
 	long lookupBlock = (event.get_logical_address() >> addressShift);
 	Address eventAddress = Address(event.get_logical_address(), PAGE);
 
-	LogPageBlock *logBlock = NULL;
-	if (log_map.find(lookupBlock) != log_map.end())
-		logBlock = log_map[lookupBlock];
+	LogPageBlock *logBlock = log_map[lookupBlock];
 
 	controller.stats.numMemoryRead++;
 
@@ -139,7 +151,7 @@ enum status FtlImpl_Bast::write(Event &event)
 
 	Address eventAddress = Address(event.get_logical_address(), PAGE);
 
-	if (log_map.find(lba) == log_map.end())
+	if (log_map[lba] == NULL)
 		allocate_new_logblock(logBlock, lba, event);
 
 	controller.stats.numMemoryRead++;
@@ -197,9 +209,7 @@ enum status FtlImpl_Bast::trim(Event &event)
 	long lookupBlock = (event.get_logical_address() >> addressShift);
 	Address eventAddress = Address(event.get_logical_address(), PAGE);
 
-	LogPageBlock *logBlock = NULL;
-	if (log_map.find(lookupBlock) != log_map.end())
-		logBlock = log_map[lookupBlock];
+	LogPageBlock *logBlock = log_map[lookupBlock];
 
 	controller.stats.numMemoryRead++;
 
@@ -216,7 +226,7 @@ enum status FtlImpl_Bast::trim(Event &event)
 		if (lBlock->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
 		{
 			dispose_logblock(logBlock, lookupBlock);
-			Block_manager::instance()->erase_and_invalidate(event, returnAddress, LOG);
+			manager.erase_and_invalidate(event, returnAddress, LOG);
 		}
 
 	}
@@ -230,7 +240,7 @@ enum status FtlImpl_Bast::trim(Event &event)
 		if (dBlock->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
 		{
 			data_list[lookupBlock] = -1;
-			Block_manager::instance()->erase_and_invalidate(event, dataAddress, DATA);
+			manager.erase_and_invalidate(event, dataAddress, DATA);
 		}
 
 	}
@@ -247,16 +257,10 @@ enum status FtlImpl_Bast::trim(Event &event)
 
 void FtlImpl_Bast::allocate_new_logblock(LogPageBlock *logBlock, long lba, Event &event)
 {
-	if (log_map.size() >= BAST_LOG_PAGE_LIMIT)
+	if (log_count >= BAST_LOG_PAGE_LIMIT)
 	{
-		int victim = random()%log_map.size()-1;
-		std::map<long, LogPageBlock*>::iterator it = log_map.begin();
-
-		for (int i=0;i<victim;i++)
-			it++;
-
-		long exLogicalBlock = (*it).first;
-		LogPageBlock *exLogBlock = (*it).second;
+		long exLogicalBlock = log_lbns[random()%log_count];
+		LogPageBlock *exLogBlock = log_map[exLogicalBlock];
 
 		if (!is_sequential(exLogBlock, exLogicalBlock, event))
 			random_merge(exLogBlock, exLogicalBlock, event);
@@ -265,15 +269,26 @@ void FtlImpl_Bast::allocate_new_logblock(LogPageBlock *logBlock, long lba, Event
 	}
 
 	logBlock = new LogPageBlock();
-	logBlock->address = Block_manager::instance()->get_free_block(LOG, event);
+	logBlock->address = manager.get_free_block(LOG, event);
 
 	//printf("Using new log block with address: %lu Block: %u\n", logBlock->address.get_linear_address(), logBlock->address.block);
 	log_map[lba] = logBlock;
+	logBlock->index = log_count;
+	log_lbns[log_count++] = lba;
 }
 
 void FtlImpl_Bast::dispose_logblock(LogPageBlock *logBlock, long lba)
 {
-	log_map.erase(lba);
+	log_map[lba] = NULL;
+
+	// Move the last entry into the freed slot
+	long last = log_lbns[--log_count];
+	if (last != lba)
+	{
+		log_lbns[logBlock->index] = last;
+		log_map[last]->index = logBlock->index;
+	}
+
 	delete logBlock;
 }
 
@@ -294,13 +309,13 @@ bool FtlImpl_Bast::is_sequential(LogPageBlock* logBlock, long lba, Event &event)
 
 	if (isSequential)
 	{
-		Block_manager::instance()->promote_block(DATA);
+		manager.promote_block(DATA);
 
 		// Add to empty list i.e. switch without erasing the datablock.
 		if (data_list[lba] != -1)
 		{
 			Address a = Address(data_list[lba], PAGE);
-			Block_manager::instance()->erase_and_invalidate(event, a, DATA);
+			manager.erase_and_invalidate(event, a, DATA);
 		}
 
 		data_list[lba] = logBlock->address.get_linear_address();
@@ -326,7 +341,7 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 	 */
 
 	Address eventAddress = Address(event.get_logical_address(), PAGE);
-	Address newDataBlock = Block_manager::instance()->get_free_block(DATA, event);
+	Address newDataBlock = manager.get_free_block(DATA, event);
 
 	int t=0;
 	for (uint i=0;i<BLOCK_SIZE;i++)
@@ -346,13 +361,13 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 		if (controller.get_state(readAddress) == INVALID) // A page might be invalidated by trim
 			continue;
 
-		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 		readEvent.set_address(readAddress);
 		controller.issue(readEvent);
 
-		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
+		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken()+readEvent.get_time_taken());
 		writeEvent.set_address(Address(newDataBlock.get_linear_address() + i, PAGE));
-		writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
+		writeEvent.set_payload(controller.get_page_data(readAddress.get_linear_address()));
 		writeEvent.set_replace_address(readAddress);
 		controller.issue(writeEvent);
 
@@ -370,12 +385,12 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 
 	// Invalidate inactive pages (LOG and DATA
 
-	Block_manager::instance()->erase_and_invalidate(event, logBlock->address, LOG);
+	manager.erase_and_invalidate(event, logBlock->address, LOG);
 
 	if (data_list[lba] != -1)
 	{
 		Address a = Address(data_list[lba], PAGE);
-		Block_manager::instance()->erase_and_invalidate(event, a, DATA);
+		manager.erase_and_invalidate(event, a, DATA);
 	}
 
 	// Update mapping
@@ -390,7 +405,7 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 
 void FtlImpl_Bast::update_map_block(Event &event)
 {
-	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 	writeEvent.set_address(Address(0, PAGE));
 	writeEvent.set_noop(true);
 
@@ -405,6 +420,6 @@ void FtlImpl_Bast::update_map_block(Event &event)
 
 void FtlImpl_Bast::print_ftl_statistics()
 {
-	Block_manager::instance()->print_statistics();
+	manager.print_statistics();
 }
 
@@ -86,10 +86,10 @@ enum status FtlImpl_BDftl::read(Event &event)
 	} else { // DFTL lookup
 		resolve_mapping(event, false);
 
-		MPage current = trans_map[dlpn];
+		long ppn = get_mapping(dlpn);
 
-		if (current.ppn != -1)
-			event.set_address(Address(current.ppn, PAGE));
+		if (ppn != -1)
+			event.set_address(Address(ppn, PAGE));
 		else
 		{
 			event.set_address(Address(0, PAGE));
@@ -121,7 +121,7 @@ enum status FtlImpl_BDftl::write(Event &event)
 
 		// Get new block if necessary
 		if (block_map[dlbn].pbn == -1u && dlpn % BLOCK_SIZE == 0)
-			block_map[dlbn].pbn = Block_manager::instance()->get_free_block(DATA, event).get_linear_address();
+			block_map[dlbn].pbn = manager.get_free_block(DATA, event).get_linear_address();
 
 		if (block_map[dlbn].pbn != -1u)
 		{
@@ -156,17 +156,11 @@ enum status FtlImpl_BDftl::write(Event &event)
 					if (b->get_state(i) != VALID)
 						continue;
 
-					MPage current = trans_map[startAdr + i];
-
-					if (current.ppn != -1)
+					if (get_mapping(startAdr + i) != -1)
 					{
-						update_translation_map(current, block_map[dlbn].pbn+i);
-						current.create_ts = event.get_start_time();
-						current.modified_ts = event.get_start_time();
-						current.cached = true;
-						trans_map.replace(trans_map.begin()+startAdr+i, current);
-
-						cmt++;
+						update_translation_map(startAdr + i, block_map[dlbn].pbn+i);
+						if (cmt_find(startAdr + i) == CMT_NIL)
+							cmt_insert(startAdr + i, true);
 
 						event.incr_time_taken(RAM_WRITE_DELAY);
 						controller.stats.numMemoryWrite++;
@@ -203,19 +197,18 @@ enum status FtlImpl_BDftl::write(Event &event)
 		long free_page = get_free_biftl_page(event);
 		resolve_mapping(event, true);
 
-		MPage current = trans_map[dlpn];
+		long ppn = get_mapping(dlpn);
 
-		Address a = Address(current.ppn, PAGE);
+		Address a = Address(ppn, PAGE);
 
-		if (current.ppn != -1)
+		if (ppn != -1)
 			event.set_replace_address(a);
 
 
-		update_translation_map(current, free_page);
-		trans_map.replace(trans_map.begin()+dlpn, current);
+		update_translation_map(dlpn, free_page);
 
 		// Finish DFTL logic
-		event.set_address(Address(current.ppn, PAGE));
+		event.set_address(Address(free_page, PAGE));
 	}
 
 	controller.stats.numMemoryRead += 3; // Block-level lookup + range check + optimal check
@@ -279,30 +272,33 @@ enum status FtlImpl_BDftl::trim(Event &event)
 	// Block-level lookup
 	if (block_map[dlbn].optimal)
 	{
-		Address address = Address(block_map[dlbn].pbn+event.get_logical_address()%BLOCK_SIZE, PAGE);
-		Block *block = controller.get_block_pointer(address);
-		block->invalidate_page(address.page);
-
-		if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
+		// Only pages written to the block so far hold data.
+		if (block_map[dlbn].pbn != -1u && dlpn % BLOCK_SIZE < block_map[dlbn].nextPage)
 		{
-			block_map[dlbn].pbn = -1;
-			block_map[dlbn].nextPage = 0;
-			Block_manager::instance()->erase_and_invalidate(event, address, DATA);
+			Address address = Address(block_map[dlbn].pbn+dlpn%BLOCK_SIZE, PAGE);
+			Block *block = controller.get_block_pointer(address);
+			block->invalidate_page(address.page);
+
+			if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
+			{
+				block_map[dlbn].pbn = -1;
+				block_map[dlbn].nextPage = 0;
+				manager.erase_and_invalidate(event, address, DATA);
+			}
 		}
 	} else { // DFTL lookup
 
-		MPage current = trans_map[dlpn];
-		if (current.ppn != -1)
+		long ppn = get_mapping(dlpn);
+		if (ppn != -1)
 		{
-			Address address = Address(current.ppn, PAGE);
+			Address address = Address(ppn, PAGE);
 			Block *block = controller.get_block_pointer(address);
 			block->invalidate_page(address.page);
 
 			evict_specific_page_from_cache(event, dlpn);
 
 			// Update translation map to default values.
-			update_translation_map(current, -1);
-			trans_map.replace(trans_map.begin()+dlpn, current);
+			update_translation_map(dlpn, -1);
 
 			event.incr_time_taken(RAM_READ_DELAY);
 			event.incr_time_taken(RAM_WRITE_DELAY);
@@ -342,6 +338,12 @@ enum status FtlImpl_BDftl::trim(Event &event)
 
 void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 {
+	if (block->get_block_type() == MAP)
+	{
+		cleanup_translation_block(event, block);
+		return;
+	}
+
 	std::map<long, long> invalidated_translation;
 	/*
 	 * 1. Copy only valid pages in the victim block to the current data block
@@ -356,7 +358,7 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 		if (block->get_state(i) == VALID)
 		{
 			// Set up events.
-			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 			readEvent.set_address(Address(block->get_physical_address()+i, PAGE));
 
 			// Execute read event
@@ -364,13 +366,13 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 				printf("Data block copy failed.");
 
 			// Get new address to write to and invalidate previous
-			Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
+			Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken()+readEvent.get_time_taken());
 			Address dataBlockAddress = Address(get_free_data_page(event, false), PAGE);
 			writeEvent.set_address(dataBlockAddress);
 			writeEvent.set_replace_address(Address(block->get_physical_address()+i, PAGE));
 
 			// Setup the write event to read from the right place.
-			writeEvent.set_payload((char*)page_data + (block->get_physical_address()+i) * PAGE_SIZE);
+			writeEvent.set_payload(controller.get_page_data(block->get_physical_address()+i));
 
 			if (controller.issue(writeEvent) == FAILURE)
 				printf("Data block copy failed.");
@@ -400,29 +402,13 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 	 * 2. Simulate translation page updates.
 	 */
 
-	std::map<long, bool> dirtied_translation_pages;
-
 	for (std::map<long, long>::const_iterator i = invalidated_translation.begin(); i!=invalidated_translation.end(); ++i)
 	{
 		long real_vpn = (*i).first;
 		long newppn = (*i).second;
 
-		// Update translation map ( it also updates the CMT, as it is stored inside the GDT )
-		MPage current = trans_map[real_vpn];
-
-		update_translation_map(current, newppn);
-
-		if (current.cached)
-			current.modified_ts = event.get_start_time();
-		else
-		{
-			current.modified_ts = event.get_start_time();
-			current.create_ts = event.get_start_time();
-			current.cached = true;
-			cmt++;
-		}
-
-		trans_map.replace(trans_map.begin()+real_vpn, current);
+		// Update translation map and the CMT entry of the page
+		migrate_mapping(real_vpn, newppn);
 	}
 }
 
@@ -430,7 +416,7 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 bool FtlImpl_BDftl::block_next_new()
 {
     //Yoohyuk Lim
-	return (currentDataPage[STREAMID_DEFAULT] == -1 || currentDataPage[STREAMID_DEFAULT] % BLOCK_SIZE == BLOCK_SIZE -1);
+	return (currentDataPage[STREAMID_DEFAULT] == -1 || is_block_end(STREAMID_DEFAULT));
 }
 
 void FtlImpl_BDftl::print_ftl_statistics()
@@ -451,6 +437,27 @@ void FtlImpl_BDftl::print_ftl_statistics()
 	}
 
 	printf(" Blocks optimal: %i\n", numOptimal);
-	Block_manager::instance()->print_statistics();
+	manager.print_statistics();
 }
 
+void FtlImpl_BDftl::snapshot(Snapshot &snapshot)
+{
+	FtlImpl_DftlParent::snapshot(snapshot);
+	snapshot.array(block_map, NUMBER_OF_ADDRESSABLE_BLOCKS);
+	snapshot.array(trim_map, NUMBER_OF_ADDRESSABLE_BLOCKS*BLOCK_SIZE);
+
+	ulong count = blockQueue.size();
+	snapshot.value(count);
+	for (ulong i = 0; i < count; i++)
+	{
+		Block *block = NULL;
+		if (!snapshot.is_loading())
+		{
+			block = blockQueue.front();
+			blockQueue.pop();
+		}
+		snapshot_block(snapshot, block);
+		blockQueue.push(block);
+	}
+	snapshot_block(snapshot, inuseBlock);
+}
@@ -61,14 +61,14 @@ enum status FtlImpl_Dftl::read(Event &event)
 	uint dlpn = event.get_logical_address();
 
 	resolve_mapping(event, false);
-	MPage current = trans_map[dlpn];
-	if (current.ppn == -1)
+	long ppn = get_mapping(dlpn);
+	if (ppn == -1)
 	{
 		event.set_address(Address(0, PAGE));
 		event.set_noop(true);
 	}
 	else
-		event.set_address(Address(current.ppn, PAGE));
+		event.set_address(Address(ppn, PAGE));
 
 	controller.stats.numFTLRead++;
 
@@ -84,15 +84,14 @@ enum status FtlImpl_Dftl::write(Event &event)
 	// Important order. As get_free_data_page might change current.
 	long free_page = get_free_data_page(event);
 
-	MPage current = trans_map[dlpn];
+	long ppn = get_mapping(dlpn);
 
-	Address a = Address(current.ppn, PAGE);
+	Address a = Address(ppn, PAGE);
 
-    if (current.ppn != -1)
+    if (ppn != -1)
 		event.set_replace_address(a);
 
-	update_translation_map(current, free_page);
-	trans_map.replace(trans_map.begin()+dlpn, current);
+	update_translation_map(dlpn, free_page);
 
 	Address b = Address(free_page, PAGE);
 	event.set_address(b);
@@ -109,19 +108,17 @@ enum status FtlImpl_Dftl::trim(Event &event)
 
 	event.set_address(Address(0, PAGE));
 
-	MPage current = trans_map[dlpn];
+	long ppn = get_mapping(dlpn);
 
-	if (current.ppn != -1)
+	if (ppn != -1)
 	{
-		Address address = Address(current.ppn, PAGE);
+		Address address = Address(ppn, PAGE);
 		Block *block = controller.get_block_pointer(address);
 		block->invalidate_page(address.page);
 
 		evict_specific_page_from_cache(event, dlpn);
 
-		update_translation_map(current, -1);
-
-		trans_map.replace(trans_map.begin()+dlpn, current);
+		update_translation_map(dlpn, -1);
 	}
 
 	controller.stats.numFTLTrim++;
@@ -132,6 +129,12 @@ enum status FtlImpl_Dftl::trim(Event &event)
 // Yoohyuk Lim
 void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 {
+	if (block->get_block_type() == MAP)
+	{
+		cleanup_translation_block(event, block);
+		return;
+	}
+
 	block_cell_type ctype = block->get_cell_type();
     uint block_size = block->get_size();
 	uint streamID = ctype == SLC ? STREAMID_PARITY : event.get_streamID();
@@ -151,7 +154,7 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 		if (block->get_state(i) == VALID)
 		{
 			// Set up events.
-			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time(), streamID);
+			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken(), streamID);
 			readEvent.set_address(Address(block->get_physical_address()+i, PAGE));
 
 			// Execute read event
@@ -159,7 +162,7 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 				printf("Data block copy failed.");
 
 			// Get new address to write to and invalidate previous
-			Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken(), streamID);
+			Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken()+readEvent.get_time_taken(), streamID);
 			Address dataBlockAddress = Address(get_free_data_page(event, false), PAGE);
 
 			writeEvent.set_address(dataBlockAddress);
@@ -167,7 +170,7 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 			writeEvent.set_replace_address(Address(block->get_physical_address()+i, PAGE));
 
 			// Setup the write event to read from the right place.
-			writeEvent.set_payload((char*)page_data + (block->get_physical_address()+i) * PAGE_SIZE);
+			writeEvent.set_payload(controller.get_page_data(block->get_physical_address()+i));
 
 			if (controller.issue(writeEvent) == FAILURE)
 				printf("Data block copy failed.");
@@ -203,29 +206,13 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 	 * 2. Simulate translation page updates.
 	 */
 
-	std::map<long, bool> dirtied_translation_pages;
-
 	for (std::map<long, long>::const_iterator i = invalidated_translation.begin(); i!=invalidated_translation.end(); ++i)
 	{
 		long real_vpn = (*i).first;
 		long newppn = (*i).second;
 
-		// Update translation map ( it also updates the CMT, as it is stored inside the GDT )
-		MPage current = trans_map[real_vpn];
-
-		update_translation_map(current, newppn);
-
-		if (current.cached)
-			current.modified_ts = event.get_start_time();
-		else
-		{
-			current.modified_ts = event.get_start_time();
-			current.create_ts = event.get_start_time();
-			current.cached = true;
-			cmt++;
-		}
-
-		trans_map.replace(trans_map.begin()+real_vpn, current);
+		// Update translation map and the CMT entry of the page
+		migrate_mapping(real_vpn, newppn);
 	}
 
 }
@@ -233,10 +220,10 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 // Yoohyuk Lim
 void FtlImpl_Dftl::print_ftl_statistics(FILE *stream)
 {
-	Block_manager::instance()->print_statistics(stream);
+	manager.print_statistics(stream);
 }
 
 void FtlImpl_Dftl::print_ftl_statistics()
 {
-	Block_manager::instance()->print_statistics();
+	manager.print_statistics();
 }
@@ -36,29 +36,11 @@
 #include <vector>
 #include <queue>
 #include <iostream>
-#include <limits>
+#include <algorithm>
 #include "../ssd.h"
 
 using namespace ssd;
 
-FtlImpl_DftlParent::MPage::MPage(long vpn)
-{
-	this->vpn = vpn;
-	this->ppn = -1;
-	this->create_ts = -1;
-	this->modified_ts = -1;
-	this->last_visited_time = -1;
-	this->cached = false;
-}
-
-double FtlImpl_DftlParent::mpage_last_visited_time_compare(const FtlImpl_DftlParent::MPage& mpage)
-{
-	if (!mpage.cached)
-		return std::numeric_limits<double>::max();
-
-	return mpage.last_visited_time;
-}
-
 FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
 	FtlParent(controller)
 {
@@ -72,6 +54,18 @@ FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
     	currentDataPage[i] = -1;
 
     currentTranslationPage = -1;
+    spareTranslationBlock = -1;
+
+    /* With multi-plane operations each stream keeps one open data block per
+     * plane of a die and hands out pages round robin over them, so
+     * consecutive pages land at the same offset of sibling planes. */
+    stripeWidth = (MULTI_PLANE_ENABLE == true) ? DIE_SIZE : 1;
+    stripePage = new long[MULTISTREAM_LEVEL * stripeWidth];
+    stripeNext = new uint[MULTISTREAM_LEVEL];
+    for (uint i=0; i<MULTISTREAM_LEVEL * stripeWidth; i++)
+    	stripePage[i] = -1;
+    for (uint i=0; i<MULTISTREAM_LEVEL; i++)
+    	stripeNext[i] = 0;
     
     // Yoohyuk Lim
     block_size = (SLC_MLC_ENABLE == true) ? MLC_BLOCK_SIZE
@@ -93,23 +87,62 @@ FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
 	// Initialise block mapping table.
 	uint ssdSize = NUMBER_OF_ADDRESSABLE_PAGES;
 
-	trans_map.reserve(ssdSize);
-	for (uint i=0;i<ssdSize;i++)
-		trans_map.push_back(MPage(i));
-
     /* Yoohyuk Lim
      * Cause the addressable blocks are different from actual block number.
      * Reverse_trans_map should have the actual number of blocks. */
-    ssdSize = NUMBER_OF_TOTAL_BLOCKS * block_size;
-	reverse_trans_map = new long[ssdSize];
+	ulong physicalSize = (ulong) NUMBER_OF_TOTAL_BLOCKS * block_size;
+	if (physicalSize >= UNMAPPED)
+	{
+		fprintf(stderr, "DFTL error: %s: %lu physical pages do not fit the 32 bit mapping table\n", __func__, physicalSize);
+		exit(MEM_ERR);
+	}
+
+	trans_map = new uint32_t[ssdSize];
+	for (uint i=0;i<ssdSize;i++)
+		trans_map[i] = UNMAPPED;
+
+	reverse_trans_map = new uint32_t[physicalSize];
+	for (ulong i=0;i<physicalSize;i++)
+		reverse_trans_map[i] = UNMAPPED;
+
+	numTranslationPages = (ssdSize + addressPerPage - 1) / addressPerPage;
+	gtd = new uint32_t[numTranslationPages];
+	tpage_gen = new uint32_t[numTranslationPages];
+	tpage_dirty = new uint32_t[numTranslationPages];
+	for (uint i=0;i<numTranslationPages;i++)
+	{
+		gtd[i] = UNMAPPED;
+		tpage_gen[i] = 1;
+		tpage_dirty[i] = 0;
+	}
+
+	// The CMT never holds more entries than there are pages to map.
+	uint cmtSize = std::min(totalCMTentries, ssdSize);
+	uint hashSize = 1;
+	while (hashSize < cmtSize)
+		hashSize <<= 1;
+
+	cmt_hash = new uint32_t[hashSize];
+	cmt_hash_mask = hashSize - 1;
+	for (uint i=0;i<hashSize;i++)
+		cmt_hash[i] = CMT_NIL;
+
+	cmt_entries.reserve(cmtSize);
+	cmt_free = CMT_NIL;
+	cmt_head = CMT_NIL;
+	cmt_tail = CMT_NIL;
 }
 
+/* Reads the translation page holding the mapping from flash. Translation
+ * pages never written hold no mappings and need no read. */
 void FtlImpl_DftlParent::consult_GTD(long dlpn, Event &event)
 {
-	// Simulate that we goto translation map and read the mapping page.
-	Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time(), event.get_streamID());
-	readEvent.set_address(Address(0, PAGE));
-	readEvent.set_noop(true);
+	uint32_t mppn = gtd[dlpn / addressPerPage];
+	if (mppn == UNMAPPED)
+		return;
+
+	Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken(), event.get_streamID());
+	readEvent.set_address(Address(mppn, PAGE));
 
 	if (controller.issue(readEvent) == FAILURE) { assert(false);}
 	//event.consolidate_metaevent(readEvent);
@@ -117,22 +150,119 @@ void FtlImpl_DftlParent::consult_GTD(long dlpn, Event &event)
 	controller.stats.numFTLRead++;
 }
 
-void FtlImpl_DftlParent::reset_MPage(FtlImpl_DftlParent::MPage &mpage)
+/* Returns the CMT entry of the page, or CMT_NIL when it is not cached. */
+uint32_t FtlImpl_DftlParent::lookup_CMT(long dlpn, Event &event)
 {
-	mpage.create_ts = -2;
-	mpage.modified_ts = -2;
-	mpage.last_visited_time = -2;
+	uint32_t entry = cmt_find(dlpn);
+	if (entry == CMT_NIL)
+		return CMT_NIL;
+
+	event.incr_time_taken(RAM_READ_DELAY);
+	controller.stats.numMemoryRead++;
+
+	return entry;
 }
 
-bool FtlImpl_DftlParent::lookup_CMT(long dlpn, Event &event)
+uint32_t FtlImpl_DftlParent::cmt_find(long dlpn) const
 {
-	if (!trans_map[dlpn].cached)
-		return false;
+	uint32_t entry = cmt_hash[dlpn & cmt_hash_mask];
+	while (entry != CMT_NIL && cmt_entries[entry].lpn != (uint32_t) dlpn)
+		entry = cmt_entries[entry].hash_next;
+	return entry;
+}
 
-	event.incr_time_taken(RAM_READ_DELAY);
-	controller.stats.numMemoryRead++;
+/* Caches the mapping of the page, clean, either as the most recently used
+ * entry or as the next one to evict. */
+uint32_t FtlImpl_DftlParent::cmt_insert(long dlpn, bool recent)
+{
+	uint32_t entry = cmt_free;
+	if (entry != CMT_NIL)
+		cmt_free = cmt_entries[entry].hash_next;
+	else
+	{
+		entry = cmt_entries.size();
+		cmt_entries.push_back(CmtEntry());
+	}
+
+	CmtEntry &e = cmt_entries[entry];
+	e.lpn = dlpn;
+	e.dirty_gen = 0;
+	e.hash_next = cmt_hash[dlpn & cmt_hash_mask];
+	cmt_hash[dlpn & cmt_hash_mask] = entry;
 
-	return true;
+	cmt_link(entry, recent);
+	cmt++;
+
+	return entry;
+}
+
+void FtlImpl_DftlParent::cmt_remove(uint32_t entry)
+{
+	uint32_t *link = &cmt_hash[cmt_entries[entry].lpn & cmt_hash_mask];
+	while (*link != entry)
+		link = &cmt_entries[*link].hash_next;
+	*link = cmt_entries[entry].hash_next;
+
+	if (cmt_is_dirty(entry))
+		tpage_dirty[cmt_entries[entry].lpn / addressPerPage]--;
+
+	cmt_unlink(entry);
+	cmt--;
+
+	cmt_entries[entry].hash_next = cmt_free;
+	cmt_free = entry;
+}
+
+void FtlImpl_DftlParent::cmt_link(uint32_t entry, bool recent)
+{
+	CmtEntry &e = cmt_entries[entry];
+	if (recent)
+	{
+		e.lru_prev = CMT_NIL;
+		e.lru_next = cmt_head;
+		if (cmt_head != CMT_NIL)
+			cmt_entries[cmt_head].lru_prev = entry;
+		else
+			cmt_tail = entry;
+		cmt_head = entry;
+	} else {
+		e.lru_prev = cmt_tail;
+		e.lru_next = CMT_NIL;
+		if (cmt_tail != CMT_NIL)
+			cmt_entries[cmt_tail].lru_next = entry;
+		else
+			cmt_head = entry;
+		cmt_tail = entry;
+	}
+}
+
+void FtlImpl_DftlParent::cmt_unlink(uint32_t entry)
+{
+	CmtEntry &e = cmt_entries[entry];
+	if (e.lru_prev != CMT_NIL)
+		cmt_entries[e.lru_prev].lru_next = e.lru_next;
+	else
+		cmt_head = e.lru_next;
+	if (e.lru_next != CMT_NIL)
+		cmt_entries[e.lru_next].lru_prev = e.lru_prev;
+	else
+		cmt_tail = e.lru_prev;
+}
+
+bool FtlImpl_DftlParent::cmt_is_dirty(uint32_t entry) const
+{
+	const CmtEntry &e = cmt_entries[entry];
+	return e.dirty_gen == tpage_gen[e.lpn / addressPerPage];
+}
+
+void FtlImpl_DftlParent::cmt_set_dirty(uint32_t entry)
+{
+	if (cmt_is_dirty(entry))
+		return;
+
+	CmtEntry &e = cmt_entries[entry];
+	e.dirty_gen = tpage_gen[e.lpn / addressPerPage];
+	tpage_dirty[e.lpn / addressPerPage]++;
 }
 
 long FtlImpl_DftlParent::get_free_data_page(Event &event)
@@ -141,13 +271,15 @@ long FtlImpl_DftlParent::get_free_data_page(Event &event)
 }
 
 /* Yoohyuk Lim
- * Check whether the given address is the end of block */
+ * Check whether the given address is the end of block
+ * The size is the one of the open block the stream writes next, which differs
+ * from the block written last when writes are striped over planes. */
 bool FtlImpl_DftlParent::is_block_end(uint streamID)
 {
-    long pageNum = currentDataPage[streamID];
+    long pageNum = *next_data_page(streamID);
 
     if (pageNum != -1) {
-        Address address = Address(currentDataPage[streamID], BLOCK);
+        Address address = Address(pageNum, BLOCK);
         uint size = controller.get_block_pointer(address)->get_size();
    
         return pageNum % block_size == size - 1;
@@ -161,22 +293,44 @@ long FtlImpl_DftlParent::get_free_data_page(Event &event, bool insert_events)
 {
     uint streamID = event.get_streamID() % MULTISTREAM_LEVEL;
     if (currentDataPage[streamID] == -1 || (is_block_end(streamID) && insert_events))
-		Block_manager::instance()->insert_events(event);
+		manager.insert_events(event);
 
     // The value of currentDataPage[streamID] is different with above one.
-	if (currentDataPage[streamID] == -1 || is_block_end(streamID)) {
+	long *page = next_data_page(streamID);
+	if (*page == -1 || is_block_end(streamID)) {
 		// controller.get_block_pointer(Address(currentDataPage[streamID], BLOCK))->print_status();
-		currentDataPage[streamID] = Block_manager::instance()->get_free_block(DATA, event).get_linear_address();
+		*page = manager.get_free_block(DATA, event).get_linear_address();
 	} else
-		currentDataPage[streamID]++;
+		(*page)++;
+
+	if (stripeWidth > 1) {
+		currentDataPage[streamID] = *page;
+		stripeNext[streamID] = (stripeNext[streamID] + 1) % stripeWidth;
+	}
 
 	return currentDataPage[streamID];
 }
 
+/* Last page handed out from the open block the next data page of the
+ * stream comes from. */
+long *FtlImpl_DftlParent::next_data_page(uint streamID)
+{
+	if (stripeWidth > 1)
+		return &stripePage[streamID * stripeWidth + stripeNext[streamID]];
+	return &currentDataPage[streamID];
+}
+
 FtlImpl_DftlParent::~FtlImpl_DftlParent(void)
 {
+	delete[] trans_map;
 	delete[] reverse_trans_map;
+	delete[] gtd;
+	delete[] tpage_gen;
+	delete[] tpage_dirty;
+	delete[] cmt_hash;
     delete[] currentDataPage; //Yoohyuk Lim
+    delete[] stripePage;
+    delete[] stripeNext;
 }
 
 void FtlImpl_DftlParent::resolve_mapping(Event &event, bool isWrite)
@@ -189,17 +343,13 @@ void FtlImpl_DftlParent::resolve_mapping(Event &event, bool isWrite)
 	 * 5. Add mapping to CMT
 	 */
 	//printf("%i\n", cmt);
-	if (lookup_CMT(event.get_logical_address(), event))
+	uint32_t entry = lookup_CMT(dlpn, event);
+	if (entry != CMT_NIL)
 	{
 		controller.stats.numCacheHits++;
 
-		MPage current = trans_map[dlpn];
-		if (isWrite)
-		{
-			current.modified_ts = event.get_start_time();			
-		}
-		current.last_visited_time = event.get_start_time();
-		trans_map.replace(trans_map.begin()+dlpn, current);
+		cmt_unlink(entry);
+		cmt_link(entry, true);
 
 		// evict_page_from_cache(event);    // no need to evict page from cache
 	} else {
@@ -209,119 +359,229 @@ void FtlImpl_DftlParent::resolve_mapping(Event &event, bool isWrite)
 
 		consult_GTD(dlpn, event);
 
-		MPage current = trans_map[dlpn];
-		current.modified_ts = event.get_start_time();
-		current.last_visited_time = event.get_start_time();
-		if (isWrite)
-			current.modified_ts++;
-		current.create_ts = event.get_start_time();
-		current.cached = true;
-		trans_map.replace(trans_map.begin()+dlpn, current);
-
-		cmt++;
+		entry = cmt_insert(dlpn, true);
 	}
+
+	if (isWrite)
+		cmt_set_dirty(entry);
 }
 
 void FtlImpl_DftlParent::evict_page_from_cache(Event &event)
 {
-	while (cmt >= totalCMTentries)
+	/* an empty CMT is full when it may hold no entries at all */
+	while (cmt >= totalCMTentries && cmt_tail != CMT_NIL)
 	{
-		// Find page to evict
-		MpageByLastVisited::iterator evictit = boost::multi_index::get<1>(trans_map).begin();
-		MPage evictPage = *evictit;
+		/* Clean pages among the least recently used are evicted for free.
+		 * Meanwhile remember the dirty one whose translation page covers
+		 * the most dirty entries. */
+		uint32_t entry = cmt_tail;
+		uint32_t victim = CMT_NIL;
+		for (uint i=0;i<CACHE_DFTL_EVICT_WINDOW && entry != CMT_NIL && cmt >= totalCMTentries;i++)
+		{
+			uint32_t prev = cmt_entries[entry].lru_prev;
 
-		assert(evictPage.cached && evictPage.create_ts >= 0 && evictPage.modified_ts >= 0);
+			if (!cmt_is_dirty(entry))
+				cmt_remove(entry);
+			else if (victim == CMT_NIL || tpage_dirty[cmt_entries[entry].lpn / addressPerPage]
+					> tpage_dirty[cmt_entries[victim].lpn / addressPerPage])
+				victim = entry;
 
-		if (evictPage.create_ts != evictPage.modified_ts)
-		{
-			// Evict page
-			// Inform the ssd model that it should invalidate the previous page.
-			// Calculate the start address of the translation page.
-			int vpnBase = evictPage.vpn - evictPage.vpn % addressPerPage;
-
-			for (int i=0;i<addressPerPage;i++)
-			{
-				MPage cur = trans_map[vpnBase+i];
-				if (cur.cached)
-				{
-					cur.create_ts = cur.modified_ts;
-					trans_map.replace(trans_map.begin()+vpnBase+i, cur);
-				}
-			}
-
-			// Simulate the write to translate page
-			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_start_time(), event.get_streamID());
-			write_event.set_address(Address(0, PAGE));
-			write_event.set_noop(true);
-
-			if (controller.issue(write_event) == FAILURE) {	assert(false);}
-
-			event.incr_time_taken(write_event.get_time_taken());
-			controller.stats.numFTLWrite++;
-			controller.stats.numCellWrite[MLC]++;
-			controller.stats.numGCWrite++;
+			entry = prev;
 		}
 
-		// Remove page from cache.
-		cmt--;
-
-		evictPage.cached = false;
-		reset_MPage(evictPage);
-		trans_map.replace(trans_map.begin()+evictPage.vpn, evictPage);
+		/* Otherwise a single translation page write cleans the victim along
+		 * with every other entry of its page, which is evicted next. */
+		if (victim != CMT_NIL && cmt >= totalCMTentries)
+			write_back_translation_page(event, cmt_entries[victim].lpn);
 	}
 }
 
 void FtlImpl_DftlParent::evict_specific_page_from_cache(Event &event, long lba)
 {
-		// Find page to evict
-		MPage evictPage = trans_map[lba];
+	uint32_t entry = cmt_find(lba);
 
-		if (!evictPage.cached)
-			return;
+	if (entry == CMT_NIL)
+		return;
 
-		assert(evictPage.cached && evictPage.create_ts >= 0 && evictPage.modified_ts >= 0);
+	if (cmt_is_dirty(entry))
+		write_back_translation_page(event, lba);
 
-		if (evictPage.create_ts != evictPage.modified_ts)
-		{
-			// Evict page
-			// Inform the ssd model that it should invalidate the previous page.
-			// Calculate the start address of the translation page.
-			int vpnBase = evictPage.vpn - evictPage.vpn % addressPerPage;
-
-			for (int i=0;i<addressPerPage;i++)
-			{
-				MPage cur = trans_map[vpnBase+i];
-				if (cur.cached)
-				{
-					cur.create_ts = cur.modified_ts;
-					trans_map.replace(trans_map.begin()+vpnBase+i, cur);
-				}
-			}
-
-			// Simulate the write to translate page
-			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_start_time(), event.get_streamID());
-			write_event.set_address(Address(0, PAGE));
-			write_event.set_noop(true);
-
-			if (controller.issue(write_event) == FAILURE) {	assert(false);}
-
-			event.incr_time_taken(write_event.get_time_taken());
-			controller.stats.numFTLWrite++;
-			controller.stats.numCellWrite[MLC]++;
-			controller.stats.numGCWrite++;
-		}
+	// Remove page from cache.
+	cmt_remove(entry);
+}
+
+/* Writes the translation page holding the mapping of the page back to
+ * flash, which cleans every cached mapping it holds. */
+void FtlImpl_DftlParent::write_back_translation_page(Event &event, long dlpn)
+{
+	long mvpn = dlpn / addressPerPage;
+
+	// Starting a new generation cleans the cached entries of the page.
+	uint32_t &gen = tpage_gen[mvpn];
+	if (++gen == 0)
+		gen = 1;
+	tpage_dirty[mvpn] = 0;
+
+	// Mappings of the page that are not cached come from the old copy.
+	if (gtd[mvpn] != UNMAPPED)
+	{
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken(), event.get_streamID());
+		readEvent.set_address(Address(gtd[mvpn], PAGE));
+
+		if (controller.issue(readEvent) == FAILURE) { assert(false);}
+
+		event.incr_time_taken(readEvent.get_time_taken());
+		controller.stats.numFTLRead++;
+	}
 
-		// Remove page from cache.
-		cmt--;
+	write_translation_page(event, mvpn);
+}
+
+/* Programs the translation page to the open translation block and points
+ * the GTD at the new copy. */
+void FtlImpl_DftlParent::write_translation_page(Event &event, long mvpn)
+{
+	// Allocation may collect garbage, which can move the page itself.
+	long mppn = get_free_translation_page(event);
+
+	Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken(), event.get_streamID());
+	write_event.set_address(Address(mppn, PAGE));
+
+	if (gtd[mvpn] != UNMAPPED)
+		write_event.set_replace_address(Address(gtd[mvpn], PAGE));
+
+	if (controller.issue(write_event) == FAILURE) {	assert(false);}
+
+	gtd[mvpn] = mppn;
+	reverse_trans_map[mppn] = mvpn;
+
+	event.incr_time_taken(write_event.get_time_taken());
+	controller.stats.numFTLWrite++;
+	controller.stats.numCellWrite[controller.get_block_pointer(write_event.get_address())->get_cell_type()]++;
+	controller.stats.numGCWrite++;
+}
+
+/* Whether the open translation block is full or there is none */
+bool FtlImpl_DftlParent::is_translation_block_end(void)
+{
+	if (currentTranslationPage == -1)
+		return true;
+
+	uint size = controller.get_block_pointer(Address(currentTranslationPage, BLOCK))->get_size();
+	return currentTranslationPage % block_size == size - 1;
+}
+
+/* Translation pages are kept apart from data in blocks of their own.
+ * Taking a free block may collect a translation block, whose pages are
+ * moved through this function and open a translation block of their own.
+ * That block is filled first and the one taken is kept as the spare. */
+long FtlImpl_DftlParent::get_free_translation_page(Event &event)
+{
+	if (!is_translation_block_end())
+		return ++currentTranslationPage;
+
+	if (spareTranslationBlock != -1)
+	{
+		currentTranslationPage = spareTranslationBlock;
+		spareTranslationBlock = -1;
+		return currentTranslationPage;
+	}
+
+	long open = currentTranslationPage;
+	long block = manager.get_free_block(MAP, event).get_linear_address();
+
+	if (currentTranslationPage != open)
+	{
+		assert(spareTranslationBlock == -1);
+		spareTranslationBlock = block;
+		return get_free_translation_page(event);
+	}
+
+	currentTranslationPage = block;
+	return currentTranslationPage;
+}
+
+/* Moves the valid translation pages of a victim block to the open
+ * translation block. */
+void FtlImpl_DftlParent::cleanup_translation_block(Event &event, Block *block)
+{
+	for (uint i=0;i<block->get_size();i++)
+	{
+		if (block->get_state(i) != VALID)
+			continue;
+
+		long mppn = block->get_physical_address()+i;
+
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken(), event.get_streamID());
+		readEvent.set_address(Address(mppn, PAGE));
+
+		if (controller.issue(readEvent) == FAILURE) { assert(false);}
+
+		event.incr_time_taken(readEvent.get_time_taken());
+		controller.stats.numFTLRead++;
+		controller.stats.numGCRead++;
+
+		write_translation_page(event, reverse_trans_map[mppn]);
+	}
+}
+
+/* Returns the physical page the logical page is mapped to, or -1. */
+long FtlImpl_DftlParent::get_mapping(long dlpn) const
+{
+	if (trans_map[dlpn] == UNMAPPED)
+		return -1;
+	return trans_map[dlpn];
+}
+
+/* Maps the logical page to the physical page, or unmaps it when ppn is -1. */
+void FtlImpl_DftlParent::update_translation_map(long dlpn, long ppn)
+{
+	if (ppn == -1)
+	{
+		trans_map[dlpn] = UNMAPPED;
+		return;
+	}
+
+	trans_map[dlpn] = ppn;
+	reverse_trans_map[ppn] = dlpn;
+}
+
+/* Remaps a page moved by garbage collection. A cached mapping becomes dirty,
+ * otherwise the mapping is cached clean and is the next to be evicted. */
+void FtlImpl_DftlParent::migrate_mapping(long dlpn, long ppn)
+{
+	// Pages written through a block level map (BDFTL) have no page mapping.
+	if (dlpn == UNMAPPED)
+		return;
 
-		evictPage.cached = false;
-		reset_MPage(evictPage);
-		trans_map.replace(trans_map.begin()+evictPage.vpn, evictPage);
+	update_translation_map(dlpn, ppn);
 
+	uint32_t entry = cmt_find(dlpn);
+	if (entry != CMT_NIL)
+		cmt_set_dirty(entry);
+	else
+		cmt_insert(dlpn, false);
 }
 
-void FtlImpl_DftlParent::update_translation_map(FtlImpl_DftlParent::MPage &mpage, long ppn)
+void FtlImpl_DftlParent::snapshot(Snapshot &snapshot)
 {
-	mpage.ppn = ppn;
-	reverse_trans_map[ppn] = mpage.vpn;
+	manager.snapshot(snapshot);
+	snapshot.array(trans_map, NUMBER_OF_ADDRESSABLE_PAGES);
+	snapshot.array(reverse_trans_map, (ulong) NUMBER_OF_TOTAL_BLOCKS * block_size);
+	snapshot.array(gtd, numTranslationPages);
+	snapshot.array(tpage_gen, numTranslationPages);
+	snapshot.array(tpage_dirty, numTranslationPages);
+
+	snapshot.vector(cmt_entries);
+	snapshot.array(cmt_hash, cmt_hash_mask + 1);
+	snapshot.value(cmt_free);
+	snapshot.value(cmt_head);
+	snapshot.value(cmt_tail);
+	snapshot.value(cmt);
+
+	snapshot.array(currentDataPage, MULTISTREAM_LEVEL);
+	snapshot.value(currentTranslationPage);
+	snapshot.value(spareTranslationBlock);
+	snapshot.array(stripePage, MULTISTREAM_LEVEL * stripeWidth);
+	snapshot.array(stripeNext, MULTISTREAM_LEVEL);
 }
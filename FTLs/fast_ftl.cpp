@@ -53,6 +53,8 @@ FtlImpl_Fast::FtlImpl_Fast(Controller &controller):
 
 	log_pages = NULL;
 
+	log_hash.reserve(FAST_LOG_PAGE_LIMIT * BLOCK_SIZE);
+
 	printf("Total mapping table size: %luKB\n", NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(uint) / 1024);
 	printf("Using FAST FTL.\n");
 }
@@ -71,13 +73,13 @@ void FtlImpl_Fast::initialize_log_pages()
 	Event event = Event(WRITE, 1, 1, 0);
 	// RW
 	log_pages = new LogPageBlock;
-	log_pages->address = Block_manager::instance()->get_free_block(LOG, event);
+	log_pages->address = manager.get_free_block(LOG, event);
 
 	LogPageBlock *next = log_pages;
 	for (uint i=0;i<FAST_LOG_PAGE_LIMIT-1;i++)
 	{
 		LogPageBlock *newLPB = new LogPageBlock();
-		newLPB->address = Block_manager::instance()->get_free_block(LOG, event);
+		newLPB->address = manager.get_free_block(LOG, event);
 		next->next = newLPB;
 		next = newLPB;
 	}
@@ -92,27 +94,13 @@ enum status FtlImpl_Fast::read(Event &event)
 
 	Address eventAddress = Address(event.get_logical_address(), PAGE);
 
-	LogPageBlock *currentBlock = log_pages;
+	std::unordered_map<long, LogPage>::const_iterator logPage = log_hash.find(event.get_logical_address());
 
-	bool found = false;
-	while (!found && currentBlock != NULL)
+	bool found = logPage != log_hash.end();
+	if (found)
 	{
-		for (int i=0;i<currentBlock->numPages;i++)
-		{
-			//event.incr_time_taken(RAM_READ_DELAY);
-
-			if (currentBlock->aPages[i] == (long)event.get_logical_address())
-			{
-				Address readAddress = Address(currentBlock->address.get_linear_address() + i, PAGE);
-				event.set_address(readAddress);
-
-				// Cancel the while and for loop
-				found = true;
-				break;
-			}
-		}
-
-		currentBlock = currentBlock->next;
+		Address readAddress = Address(logPage->second.block->address.get_linear_address() + logPage->second.page, PAGE);
+		event.set_address(readAddress);
 	}
 
 	if (!found)
@@ -152,7 +140,7 @@ enum status FtlImpl_Fast::write(Event &event)
 	// if a collision occurs at offset of the data block of pbn.
 	if (data_list[logicalBlockAddress] == -1)
 	{
-		Address newBlock = Block_manager::instance()->get_free_block(DATA, event);
+		Address newBlock = manager.get_free_block(DATA, event);
 
 		// Register the mapping
 		data_list[logicalBlockAddress] = newBlock.get_linear_address();
@@ -173,7 +161,7 @@ enum status FtlImpl_Fast::write(Event &event)
 	}
 
 	// Insert go sarbage collection
-	Block_manager::instance()->insert_events(event);
+	manager.insert_events(event);
 
 	// Statistics
 	controller.stats.numFTLWrite++;
@@ -193,34 +181,26 @@ enum status FtlImpl_Fast::trim(Event &event)
 
 	Address eventAddress = Address(event.get_logical_address(), PAGE);
 
-	LogPageBlock *currentBlock = log_pages;
+	std::unordered_map<long, LogPage>::iterator logPage = log_hash.find(event.get_logical_address());
 
-	bool found = false;
-	while (!found && currentBlock != NULL)
+	bool found = logPage != log_hash.end();
+	if (found)
 	{
-		for (int i=0;i<currentBlock->numPages;i++)
-		{
-			if (currentBlock->aPages[i] == (long)event.get_logical_address())
-			{
-				Address address = Address(currentBlock->address.get_linear_address() + i, PAGE);
-				Block *block = controller.get_block_pointer(address);
-				block->invalidate_page(address.page);
+		LogPageBlock *currentBlock = logPage->second.block;
+		int i = logPage->second.page;
 
-				currentBlock->aPages[i] = -1;
+		Address address = Address(currentBlock->address.get_linear_address() + i, PAGE);
+		Block *block = controller.get_block_pointer(address);
+		block->invalidate_page(address.page);
 
-				if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
-				{
-					Block_manager::instance()->erase_and_invalidate(event, currentBlock->address, LOG);
-					data_list[lookupBlock] = -1;
-				}
+		currentBlock->aPages[i] = -1;
+		log_hash.erase(logPage);
 
-				// Cancel the while and for loop
-				found = true;
-				break;
-			}
+		if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
+		{
+			manager.erase_and_invalidate(event, currentBlock->address, LOG);
+			data_list[lookupBlock] = -1;
 		}
-
-		currentBlock = currentBlock->next;
 	}
 
 	if (!found)
@@ -233,7 +213,7 @@ enum status FtlImpl_Fast::trim(Event &event)
 
 			if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
 			{
-				Block_manager::instance()->erase_and_invalidate(event, address, LOG);
+				manager.erase_and_invalidate(event, address, LOG);
 				sequential_logicalblock_address = -1;
 			}
 
@@ -247,7 +227,7 @@ enum status FtlImpl_Fast::trim(Event &event)
 
 			if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
 			{
-				Block_manager::instance()->erase_and_invalidate(event, address, LOG);
+				manager.erase_and_invalidate(event, address, LOG);
 				data_list[lookupBlock] = -1;
 			}
 		}
@@ -257,7 +237,7 @@ enum status FtlImpl_Fast::trim(Event &event)
 	event.set_address(Address(0, PAGE));
 
 	// Insert garbage collection
-	Block_manager::instance()->insert_events(event);
+	manager.insert_events(event);
 
 	// Statistics
 	controller.stats.numFTLTrim++;
@@ -270,7 +250,7 @@ void FtlImpl_Fast::switch_sequential(Event &event)
 	// Add to empty list i.e. switch without erasing the datablock.
 
 	if (data_list[sequential_logicalblock_address] != -1)
-		Block_manager::instance()->invalidate(Address(data_list[sequential_logicalblock_address], BLOCK), DATA);
+		manager.invalidate(Address(data_list[sequential_logicalblock_address], BLOCK), DATA);
 
 	data_list[sequential_logicalblock_address] = sequential_address.get_linear_address();
 
@@ -287,11 +267,11 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 	// Do merge (n reads, n writes and 2 erases (gc'ed))
 	Address eventAddress = Address(event.get_logical_address(), PAGE);
 
-	Address newDataBlock = Block_manager::instance()->get_free_block(DATA, event);
+	Address newDataBlock = manager.get_free_block(DATA, event);
 	//printf("Using new data block with address: %lu Block: %u\n", newDataBlock.get_linear_address(), newDataBlock.block);
 
-	if (Block_manager::instance()->get_num_free_blocks() < 5)
-		Block_manager::instance()->insert_events(event);
+	if (manager.get_num_free_blocks() < 5)
+		manager.insert_events(event);
 
 	for (uint i=0;i<BLOCK_SIZE;i++)
 	{
@@ -306,12 +286,12 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 		else
 			continue; // Empty page
 
-		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 		readEvent.set_address(readAddress);
 		if (controller.issue(readEvent) == FAILURE) { printf("Read failed\n"); return; }
 
-		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-		writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
+		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken()+readEvent.get_time_taken());
+		writeEvent.set_payload(controller.get_page_data(readAddress.get_linear_address()));
 		writeEvent.set_address(Address(newDataBlock.get_linear_address() + i, PAGE));
 		if (controller.issue(writeEvent) == FAILURE) {  printf("Write failed\n"); return; }
 
@@ -325,9 +305,9 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 	}
 
 	// Invalidate inactive pages
-	Block_manager::instance()->invalidate(&sequential_address, DATA);
+	manager.invalidate(&sequential_address, DATA);
 	if (data_list[sequential_logicalblock_address] != -1)
-		Block_manager::instance()->invalidate(Address(data_list[sequential_logicalblock_address], BLOCK), DATA);
+		manager.invalidate(Address(data_list[sequential_logicalblock_address], BLOCK), DATA);
 
 	// Update mapping
 	data_list[sequential_logicalblock_address] = newDataBlock.get_linear_address();
@@ -361,10 +341,10 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 		for (uint i=0;i<BLOCK_SIZE;++i)
 			pinned[i] = false;
 
-		if (Block_manager::instance()->get_num_free_blocks() < 5)
-			Block_manager::instance()->insert_events(event);
+		if (manager.get_num_free_blocks() < 5)
+			manager.insert_events(event);
 
-		Address mergeAddress = Block_manager::instance()->get_free_block(DATA, event);
+		Address mergeAddress = manager.get_free_block(DATA, event);
 
 		long victimLBA = m->first;
 		if (victimLBA == -1)
@@ -396,15 +376,15 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 					else if (get_state(writeAddress) == EMPTY)
 					{
 						// Read the active log address
-						Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+						Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 						Address readAddress = Address(lpb->address.get_linear_address()+i, PAGE);
 						readEvent.set_address(readAddress);
 
 						if (controller.issue(readEvent) == FAILURE) { printf("failed\n"); return false; }
 						//event.consolidate_metaevent(readEvent);
 
-						Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-						writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
+						Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken()+readEvent.get_time_taken());
+						writeEvent.set_payload(controller.get_page_data(readAddress.get_linear_address()));
 						writeEvent.set_address(writeAddress);
 
 						if (controller.issue(writeEvent) == FAILURE) { printf("failed\n"); return false; }
@@ -434,14 +414,14 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 				Address readAddress = Address(data_list[victimLBA] + i, PAGE);
 				if (get_state(readAddress) == VALID)
 				{
-					Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+					Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 					readEvent.set_address(readAddress);
 					if (controller.issue(readEvent) == FAILURE) { printf("failed\n"); return false;	}
 					//event.consolidate_metaevent(readEvent);
 
 					// Write the page to merge address
-					Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-					writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
+					Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken()+readEvent.get_time_taken());
+					writeEvent.set_payload(controller.get_page_data(readAddress.get_linear_address()));
 					writeEvent.set_address(writeAddress);
 					if (controller.issue(writeEvent) == FAILURE) { printf("failed\n"); return false;	}
 					//event.consolidate_metaevent(writeEvent);
@@ -460,10 +440,13 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 		}
 
 		// Invalidate inactive pages
-		Block_manager::instance()->invalidate(Address(data_list[victimLBA], BLOCK), DATA);
+		manager.invalidate(Address(data_list[victimLBA], BLOCK), DATA);
 
 		data_list[victimLBA] = mergeAddress.get_linear_address();
 
+		// The logical block is read from the merged data block from now on.
+		forget_logical_block(victimLBA);
+
 	}
 
 	controller.stats.numLogMergeFull++;
@@ -499,7 +482,7 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 		 */
 
 		sequential_offset = 1;
-		sequential_address = Block_manager::instance()->get_free_block(DATA, event);
+		sequential_address = manager.get_free_block(DATA, event);
 		sequential_logicalblock_address = logicalBlockAddress;
 
 		event.set_address(sequential_address);
@@ -523,7 +506,7 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 				merge_sequential(event);
 
 				sequential_offset = 1;
-				sequential_address = Block_manager::instance()->get_free_block(DATA, event);
+				sequential_address = manager.get_free_block(DATA, event);
 				sequential_logicalblock_address = logicalBlockAddress;
 
 				// Append data to the SW log block
@@ -546,12 +529,12 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 
 				// Maintain the log page list
 				log_pages = log_pages->next;
-				Block_manager::instance()->invalidate(&victim->address, LOG);
+				manager.invalidate(&victim->address, LOG);
 				delete victim;
 
 				// Create new LogPageBlock and append it to the log_pages list.
 				LogPageBlock *newLPB = new LogPageBlock();
-				newLPB->address = Block_manager::instance()->get_free_block(LOG, event);
+				newLPB->address = manager.get_free_block(LOG, event);
 
 				LogPageBlock *next = log_pages;
 				while (next->next != NULL) next = next->next;
@@ -569,6 +552,10 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 			victim->aPages[log_page_next % BLOCK_SIZE] = event.get_logical_address();
 			victim->numPages++;
 
+			LogPage &logPage = log_hash[event.get_logical_address()];
+			logPage.block = victim;
+			logPage.page = log_page_next % BLOCK_SIZE;
+
 			Address rw = victim->address;
 			rw.valid = PAGE;
 			rw += log_page_next % BLOCK_SIZE;
@@ -581,9 +568,18 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 	return true;
 }
 
+/* Drops the log page lookup of every page of the logical block. */
+void FtlImpl_Fast::forget_logical_block(long logicalBlockAddress)
+{
+	long start = logicalBlockAddress << addressShift;
+
+	for (uint i=0;i<BLOCK_SIZE;i++)
+		log_hash.erase(start + i);
+}
+
 void FtlImpl_Fast::update_map_block(Event &event)
 {
-	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 	writeEvent.set_address(Address(0, PAGE));
 	writeEvent.set_noop(true);
 
@@ -598,6 +594,6 @@ void FtlImpl_Fast::update_map_block(Event &event)
 
 void FtlImpl_Fast::print_ftl_statistics()
 {
-	Block_manager::instance()->print_statistics();
+	manager.print_statistics();
 }
 
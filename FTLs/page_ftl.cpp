@@ -17,7 +17,9 @@
 
 /****************************************************************************/
 
-/* Implements a very simple page-level FTL without merge */
+/* Implements a page-level FTL. Every logical page is mapped in RAM, writes
+ * are appended to open blocks spread over all dies and garbage is collected
+ * greedily by the Block_manager. */
 
 #include <new>
 #include <assert.h>
@@ -30,23 +32,63 @@ using namespace ssd;
 FtlImpl_Page::FtlImpl_Page(Controller &controller):
 	FtlParent(controller)
 {
-	trim_map = new bool[NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE];
+	block_size = (SLC_MLC_ENABLE == true) ? MLC_BLOCK_SIZE
+	                                      : BLOCK_SIZE;
 
-	numPagesActive = 0;
+	ulong physicalSize = (ulong) NUMBER_OF_TOTAL_BLOCKS * block_size;
+	if (physicalSize >= UNMAPPED)
+	{
+		fprintf(stderr, "Page FTL error: %s: %lu physical pages do not fit the 32 bit mapping table\n", __func__, physicalSize);
+		exit(MEM_ERR);
+	}
+
+	map = new uint32_t[NUMBER_OF_ADDRESSABLE_PAGES];
+	for (uint i=0;i<NUMBER_OF_ADDRESSABLE_PAGES;i++)
+		map[i] = UNMAPPED;
+
+	reverse_map = new uint32_t[physicalSize];
+	for (ulong i=0;i<physicalSize;i++)
+		reverse_map[i] = UNMAPPED;
+
+	// One open block per die, or per plane with multi-plane operations.
+	openWidth = SSD_SIZE * PACKAGE_SIZE;
+	if (MULTI_PLANE_ENABLE == true)
+		openWidth *= DIE_SIZE;
+
+	openNext = 0;
+	openPage = new long[openWidth];
+	for (uint i=0;i<openWidth;i++)
+		openPage[i] = -1;
+
+	gcPage = -1;
+
+	// Blocks allocated one after another land on different dies.
+	manager.stripe_dies();
 
-	return;
+	printf("Using Page FTL.\n");
 }
 
 FtlImpl_Page::~FtlImpl_Page(void)
 {
-
-	return;
+	delete[] map;
+	delete[] reverse_map;
+	delete[] openPage;
 }
 
 enum status FtlImpl_Page::read(Event &event)
 {
-	event.set_address(Address(0, PAGE));
-	event.set_noop(true);
+	uint dlpn = event.get_logical_address();
+
+	event.incr_time_taken(RAM_READ_DELAY);
+	controller.stats.numMemoryRead++;
+
+	if (map[dlpn] == UNMAPPED)
+	{
+		event.set_address(Address(0, PAGE));
+		event.set_noop(true);
+	}
+	else
+		event.set_address(Address(map[dlpn], PAGE));
 
 	controller.stats.numFTLRead++;
 
@@ -55,67 +97,145 @@ enum status FtlImpl_Page::read(Event &event)
 
 enum status FtlImpl_Page::write(Event &event)
 {
-	event.set_address(Address(1, PAGE));
-	event.set_noop(true);
+	uint dlpn = event.get_logical_address();
+
+	// Important order. As get_free_page might move the page.
+	long free_page = get_free_page(event, true);
+
+	if (map[dlpn] != UNMAPPED)
+		event.set_replace_address(Address(map[dlpn], PAGE));
+
+	map[dlpn] = free_page;
+	reverse_map[free_page] = dlpn;
+
+	event.incr_time_taken(RAM_WRITE_DELAY);
+	controller.stats.numMemoryWrite++;
+
+	Address address = Address(free_page, PAGE);
+	event.set_address(address);
 
 	controller.stats.numFTLWrite++;
+	controller.stats.numCellWrite[controller.get_block_pointer(address)->get_cell_type()]++;
 
-	if (numPagesActive == NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE)
-	{
-		numPagesActive -= BLOCK_SIZE;
+	return controller.issue(event);
+}
 
-		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
-		eraseEvent.set_address(Address(0, PAGE));
+enum status FtlImpl_Page::trim(Event &event)
+{
+	uint dlpn = event.get_logical_address();
 
-		if (controller.issue(eraseEvent) == FAILURE) printf("Erase failed");
+	if (map[dlpn] != UNMAPPED)
+	{
+		Address address = Address(map[dlpn], PAGE);
+		Block *block = controller.get_block_pointer(address);
+		block->invalidate_page(address.page);
 
-		event.incr_time_taken(eraseEvent.get_time_taken());
+		map[dlpn] = UNMAPPED;
 
-		controller.stats.numFTLErase++;
-		controller.stats.numFTLWL++;
+		event.incr_time_taken(RAM_WRITE_DELAY);
+		controller.stats.numMemoryWrite++;
 	}
 
-	numPagesActive++;
+	event.set_address(Address(0, PAGE));
+	event.set_noop(true);
 
+	controller.stats.numFTLTrim++;
 
 	return controller.issue(event);
 }
 
-enum status FtlImpl_Page::trim(Event &event)
+/* Host writes go round robin over the open blocks. Pages moved by garbage
+ * collection have an open block of their own, so collecting never touches
+ * the block a host write is being placed in. */
+long FtlImpl_Page::get_free_page(Event &event, bool insert_events)
 {
-	controller.stats.numFTLTrim++;
+	if (!insert_events)
+		return next_page(gcPage, event);
 
-	uint dlpn = event.get_logical_address();
+	long &page = openPage[openNext];
+	openNext = (openNext + 1) % openWidth;
 
-	if (!trim_map[event.get_logical_address()])
-		trim_map[event.get_logical_address()] = true;
+	if (page == -1 || page % block_size == controller.get_block_pointer(Address(page, BLOCK))->get_size() - 1)
+		manager.insert_events(event);
 
-	// Update trim map and update block map if all pages are trimmed. i.e. the state are reseted to optimal.
-	long addressStart = dlpn - dlpn % BLOCK_SIZE;
-	bool allTrimmed = true;
-	for (uint i=addressStart;i<addressStart+BLOCK_SIZE;i++)
-	{
-		if (!trim_map[i])
-			allTrimmed = false;
-	}
+	return next_page(page, event);
+}
+
+/* Advances an open block by one page, taking a free block when it is full. */
+long FtlImpl_Page::next_page(long &page, Event &event)
+{
+	if (page == -1 || page % block_size == controller.get_block_pointer(Address(page, BLOCK))->get_size() - 1)
+		page = manager.get_free_block(DATA, event).get_linear_address();
+	else
+		page++;
+
+	return page;
+}
 
-	if (allTrimmed)
+void FtlImpl_Page::cleanup_block(Event &event, Block *block)
+{
+	/*
+	 * 1. Copy only valid pages in the victim block to the garbage collection block
+	 * 2. Invalidate old pages
+	 * 3. Update the mapping of the moved pages
+	 */
+	for (uint i=0;i<block->get_size();i++)
 	{
-		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
-		eraseEvent.set_address(Address(0, PAGE));
+		if (block->get_state(i) != VALID)
+			continue;
+
+		long ppn = block->get_physical_address()+i;
+
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken(), event.get_streamID());
+		readEvent.set_address(Address(ppn, PAGE));
+
+		if (controller.issue(readEvent) == FAILURE)
+			printf("Data block copy failed.");
 
-		if (controller.issue(eraseEvent) == FAILURE) printf("Erase failed");
+		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken()+readEvent.get_time_taken(), event.get_streamID());
+		Address dataBlockAddress = Address(get_free_page(event, false), PAGE);
 
-		event.incr_time_taken(eraseEvent.get_time_taken());
+		writeEvent.set_address(dataBlockAddress);
+		writeEvent.set_replace_address(Address(ppn, PAGE));
 
-		for (uint i=addressStart;i<addressStart+BLOCK_SIZE;i++)
-			trim_map[i] = false;
+		// Setup the write event to read from the right place.
+		writeEvent.set_payload(controller.get_page_data(ppn));
 
-		controller.stats.numFTLErase++;
-		controller.stats.numFTLWL++;
+		if (controller.issue(writeEvent) == FAILURE)
+			printf("Data block copy failed.");
 
-		numPagesActive -= BLOCK_SIZE;
+		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+
+		long dlpn = reverse_map[ppn];
+		long newppn = dataBlockAddress.get_linear_address();
+		map[dlpn] = newppn;
+		reverse_map[newppn] = dlpn;
+
+		controller.stats.numFTLRead++;
+		controller.stats.numFTLWrite++;
+		controller.stats.numGCRead++;
+		controller.stats.numGCWrite++;
+		controller.stats.numCellWrite[block->get_cell_type()]++;
+		controller.stats.numMemoryWrite++;
 	}
+}
 
-	return SUCCESS;
+void FtlImpl_Page::print_ftl_statistics(FILE *stream)
+{
+	manager.print_statistics(stream);
+}
+
+void FtlImpl_Page::print_ftl_statistics()
+{
+	manager.print_statistics();
+}
+
+void FtlImpl_Page::snapshot(Snapshot &snapshot)
+{
+	manager.snapshot(snapshot);
+	snapshot.array(map, NUMBER_OF_ADDRESSABLE_PAGES);
+	snapshot.array(reverse_map, (ulong) NUMBER_OF_TOTAL_BLOCKS * block_size);
+	snapshot.value(openNext);
+	snapshot.array(openPage, openWidth);
+	snapshot.value(gcPage);
 }
@@ -0,0 +1,412 @@
+/* run_bench.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Microbenchmarks
+ *
+ * usage: bench [-o results file] [config file] [benchmark name]
+ *
+ * Times the hot paths of the simulator to give performance work a baseline:
+ *
+ * 	address_linear     Address::set_linear_address
+ * 	channel_lock       Channel::lock with transfers spread over a window of
+ * 	                   the given number of transfers, so that about half as
+ * 	                   many reservations are pending in the table
+ * 	update_block       Block_manager::update_block moving blocks between
+ * 	                   cost buckets
+ * 	victim_selection   Block_manager::first_victim and next_victim walking
+ * 	                   the given number of victims, as garbage collection does
+ * 	resolve_mapping    DFTL resolve_mapping with the given percentage of
+ * 	                   Cached Mapping Table hits, including the construction
+ * 	                   of the request event
+ * 	write_fill         host writes of single pages through Ssd::event_arrive
+ * 	                   over the addressable pages in sequential or random
+ * 	                   order, from an empty drive on
+ *
+ * Every benchmark runs BENCH_REPEATS times on fresh state with fixed seeds.
+ * A line per benchmark gives the median and the fastest time per operation
+ * and the items per second at the median, an item being a page for the
+ * write fills and an operation otherwise.  Results are CSV, or JSON lines
+ * for a .json or .jsonl results file; without a results file they go to
+ * standard output together with the messages of the simulator.  The config
+ * file defaults to bench.conf, which fixes the geometry so that builds can
+ * be compared, and the benchmark name selects the benchmarks that start
+ * with it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "ssd.h"
+
+using namespace ssd;
+
+#define BENCH_REPEATS 5
+
+/* results are consumed here so that the compiler cannot drop the work */
+static volatile ulong sink;
+
+namespace ssd {
+
+/* Reaches into the Block_manager and the DFTL for the benchmarks */
+class Benchmark
+{
+public:
+	static FtlParent &get_ftl(Ssd &ssd)
+	{
+		return *ssd.get_block_manager().ftl;
+	}
+
+	static Block *first_victim(Block_manager &manager)
+	{
+		return manager.first_victim();
+	}
+
+	static Block *next_victim(Block_manager &manager, const Block *block)
+	{
+		return manager.next_victim(block);
+	}
+
+	static void resolve_mapping(FtlImpl_DftlParent &ftl, Event &event)
+	{
+		ftl.resolve_mapping(event, false);
+	}
+
+	static uint get_cmt_entries(const FtlImpl_DftlParent &ftl)
+	{
+		return ftl.totalCMTentries;
+	}
+};
+
+}
+
+struct BenchResult
+{
+	ulong operations;
+	ulong items;
+	double seconds;
+};
+
+typedef BenchResult (*bench_function)(uint parameter);
+
+class BenchTimer
+{
+public:
+	BenchTimer(void): start(std::chrono::steady_clock::now()) {}
+
+	double elapsed(void) const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+/* xorshift, the same sequence on every platform */
+static ulong next_random(ulong &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static ulong physical_pages(void)
+{
+	return (ulong) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE;
+}
+
+static BenchResult bench_address_linear(uint parameter)
+{
+	const ulong operations = 4000000;
+	ulong pages = physical_pages();
+	ulong address = 0;
+	ulong sum = 0;
+	Address physical;
+
+	BenchTimer timer;
+	for (ulong i = 0; i < operations; i++)
+	{
+		physical.set_linear_address(address);
+		sum += physical.page + physical.block + physical.plane + physical.die + physical.package;
+
+		/* a prime stride visits every part of the address */
+		address += 7919;
+		if (address >= pages)
+			address -= pages;
+	}
+	BenchResult result = {operations, operations, timer.elapsed()};
+	sink = sum;
+	return result;
+}
+
+static BenchResult bench_channel_lock(uint depth)
+{
+	const ulong operations = 1000000;
+	double duration = BUS_CTRL_DELAY + BUS_DATA_DELAY;
+	std::vector<double> starts(operations);
+	ulong state = 0x9e3779b97f4a7c15ul;
+
+	/* one transfer every two durations keeps the channel half busy */
+	for (ulong i = 0; i < operations; i++)
+		starts[i] = (i + next_random(state) % depth) * 2.0 * duration;
+
+	Channel channel;
+	Event event(WRITE, 0, 1, 0.0);
+
+	BenchTimer timer;
+	for (ulong i = 0; i < operations; i++)
+		(void) channel.lock(i * 2.0 * duration, starts[i], duration, event);
+	BenchResult result = {operations, operations, timer.elapsed()};
+	sink = (ulong) event.get_time_taken();
+	return result;
+}
+
+/* every block of the Ssd, created on first use */
+static void get_blocks(Ssd &ssd, std::vector<Block *> &blocks)
+{
+	FtlParent &ftl = Benchmark::get_ftl(ssd);
+	ulong count = (ulong) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE;
+
+	blocks.clear();
+	for (ulong b = 0; b < count; b++)
+		blocks.push_back(ftl.get_block_pointer(Address(b * BLOCK_SIZE, BLOCK)));
+}
+
+static BenchResult bench_update_block(uint parameter)
+{
+	const ulong operations = 2000000;
+	Ssd ssd;
+	Block_manager &manager = ssd.get_block_manager();
+	std::vector<Block *> blocks;
+	get_blocks(ssd, blocks);
+
+	std::vector<std::pair<Block *, uint> > updates(operations);
+	ulong state = 0x2545f4914f6cdd1dul;
+	for (ulong i = 0; i < operations; i++)
+	{
+		Block *block = blocks[next_random(state) % blocks.size()];
+		updates[i] = std::make_pair(block, (uint) (next_random(state) % (block->get_size() + 1)));
+	}
+
+	BenchTimer timer;
+	for (ulong i = 0; i < operations; i++)
+	{
+		updates[i].first->pages_invalid = updates[i].second;
+		manager.update_block(updates[i].first);
+	}
+	BenchResult result = {operations, operations, timer.elapsed()};
+	return result;
+}
+
+static BenchResult bench_victim_selection(uint walk)
+{
+	const ulong operations = 1000000;
+	Ssd ssd;
+	Block_manager &manager = ssd.get_block_manager();
+	std::vector<Block *> blocks;
+	get_blocks(ssd, blocks);
+
+	ulong state = 0x5851f42d4c957f2dul;
+	for (ulong b = 0; b < blocks.size(); b++)
+	{
+		blocks[b]->pages_invalid = next_random(state) % (blocks[b]->get_size() + 1);
+		manager.update_block(blocks[b]);
+	}
+
+	ulong sum = 0;
+	BenchTimer timer;
+	for (ulong i = 0; i < operations; i++)
+	{
+		Block *block = Benchmark::first_victim(manager);
+		for (uint w = 1; w < walk && block != NULL; w++)
+			block = Benchmark::next_victim(manager, block);
+		sum += block != NULL ? block->pages_invalid : 0;
+	}
+	BenchResult result = {operations, operations, timer.elapsed()};
+	sink = sum;
+	return result;
+}
+
+/* An eighth of the Cached Mapping Table holds the hot pages that hit, misses
+ * go to pages cycling through the rest of the drive, which evict the oldest
+ * entries but hardly ever the hot ones that are used all the time. */
+static BenchResult bench_resolve_mapping(uint hit_percent)
+{
+	const ulong operations = 1000000;
+	Ssd ssd;
+	FtlImpl_DftlParent *ftl = dynamic_cast<FtlImpl_DftlParent *>(&Benchmark::get_ftl(ssd));
+	if (ftl == NULL)
+	{
+		fprintf(stderr, "Bench error: %s: resolve_mapping needs DFTL (FTL_IMPLEMENTATION 3 or 4)\n", __func__);
+		exit(-1);
+	}
+
+	ulong hot = Benchmark::get_cmt_entries(*ftl) / 8;
+	ulong pages = NUMBER_OF_ADDRESSABLE_PAGES;
+	if (hot == 0 || pages < 4 * hot)
+	{
+		fprintf(stderr, "Bench error: %s: the Cached Mapping Table must hold less than a quarter of the pages\n", __func__);
+		exit(-1);
+	}
+
+	std::vector<uint> addresses(operations);
+	ulong state = 0x14057b7ef767814ful;
+	ulong cold = 0;
+	for (ulong i = 0; i < operations; i++)
+	{
+		if (next_random(state) % 100 < hit_percent)
+			addresses[i] = next_random(state) % hot;
+		else
+		{
+			addresses[i] = hot + cold;
+			cold = (cold + 1) % (pages - hot);
+		}
+	}
+
+	for (ulong lpn = 0; lpn < hot; lpn++)
+	{
+		Event event(READ, lpn, 1, 0.0);
+		Benchmark::resolve_mapping(*ftl, event);
+	}
+
+	BenchTimer timer;
+	for (ulong i = 0; i < operations; i++)
+	{
+		Event event(READ, addresses[i], 1, 0.0);
+		Benchmark::resolve_mapping(*ftl, event);
+	}
+	BenchResult result = {operations, operations, timer.elapsed()};
+	return result;
+}
+
+static BenchResult bench_write_fill(uint random)
+{
+	ulong pages = NUMBER_OF_ADDRESSABLE_PAGES;
+	std::vector<ulong> addresses(pages);
+	ulong state = 0xda942042e4dd58b5ul;
+	for (ulong i = 0; i < pages; i++)
+		addresses[i] = random ? next_random(state) % pages : i;
+
+	Ssd ssd;
+	double time = 0.0;
+
+	BenchTimer timer;
+	for (ulong i = 0; i < pages; i++)
+		time += ssd.event_arrive(WRITE, addresses[i], 1, time);
+	BenchResult result = {pages, pages, timer.elapsed()};
+	sink = (ulong) time;
+	return result;
+}
+
+struct BenchCase
+{
+	const char *name;
+	const char *parameter_name;
+	uint parameter;
+	bench_function function;
+};
+
+static const BenchCase bench_cases[] = {
+	{"address_linear", "", 0, bench_address_linear},
+	{"channel_lock", "depth=1", 1, bench_channel_lock},
+	{"channel_lock", "depth=16", 16, bench_channel_lock},
+	{"channel_lock", "depth=256", 256, bench_channel_lock},
+	{"channel_lock", "depth=4096", 4096, bench_channel_lock},
+	{"update_block", "", 0, bench_update_block},
+	{"victim_selection", "walk=1", 1, bench_victim_selection},
+	{"victim_selection", "walk=5", 5, bench_victim_selection},
+	{"victim_selection", "walk=64", 64, bench_victim_selection},
+	{"resolve_mapping", "hits=100%", 100, bench_resolve_mapping},
+	{"resolve_mapping", "hits=90%", 90, bench_resolve_mapping},
+	{"resolve_mapping", "hits=50%", 50, bench_resolve_mapping},
+	{"resolve_mapping", "hits=0%", 0, bench_resolve_mapping},
+	{"write_fill", "sequential", 0, bench_write_fill},
+	{"write_fill", "random", 1, bench_write_fill}
+};
+
+static bool by_time_per_operation(const BenchResult &a, const BenchResult &b)
+{
+	return a.seconds / a.operations < b.seconds / b.operations;
+}
+
+int main(int argc, char **argv)
+{
+	const char *output = NULL;
+	const char *config = "bench.conf";
+	const char *filter = "";
+	int arg = 1;
+
+	if (arg + 1 < argc && !strcmp(argv[arg], "-o"))
+	{
+		output = argv[arg + 1];
+		arg += 2;
+	}
+	if (arg < argc)
+		config = argv[arg++];
+	if (arg < argc)
+		filter = argv[arg++];
+	if (arg < argc)
+	{
+		fprintf(stderr, "usage: %s [-o results file] [config file] [benchmark name]\n", argv[0]);
+		exit(-1);
+	}
+
+	load_config(config);
+
+	FILE *stream = stdout;
+	if (output != NULL && (stream = fopen(output, "w")) == NULL)
+	{
+		fprintf(stderr, "Bench error: %s: could not create results file %s\n", __func__, output);
+		exit(FILE_ERR);
+	}
+	const char *extension = output != NULL ? strrchr(output, '.') : NULL;
+	bool json = extension != NULL && (!strcmp(extension, ".json") || !strcmp(extension, ".jsonl"));
+
+	if (!json)
+		fprintf(stream, "benchmark,parameter,repeats,operations,items,ns_per_op,min_ns_per_op,items_per_sec\n");
+
+	for (uint c = 0; c < sizeof(bench_cases) / sizeof(bench_cases[0]); c++)
+	{
+		const BenchCase &bench = bench_cases[c];
+		if (strncmp(bench.name, filter, strlen(filter)))
+			continue;
+
+		std::vector<BenchResult> results;
+		for (uint r = 0; r < BENCH_REPEATS; r++)
+			results.push_back(bench.function(bench.parameter));
+		std::sort(results.begin(), results.end(), by_time_per_operation);
+
+		const BenchResult &median = results[BENCH_REPEATS / 2];
+		double ns_per_op = median.seconds * 1e9 / median.operations;
+		double min_ns_per_op = results[0].seconds * 1e9 / results[0].operations;
+		double items_per_sec = median.seconds > 0.0 ? median.items / median.seconds : 0.0;
+
+		if (json)
+			fprintf(stream, "{\"benchmark\":\"%s\",\"parameter\":\"%s\",\"repeats\":%u,\"operations\":%lu,\"items\":%lu,"
+				"\"ns_per_op\":%f,\"min_ns_per_op\":%f,\"items_per_sec\":%f}\n",
+				bench.name, bench.parameter_name, BENCH_REPEATS, median.operations, median.items, ns_per_op, min_ns_per_op, items_per_sec);
+		else
+			fprintf(stream, "%s,%s,%u,%lu,%lu,%f,%f,%f\n",
+				bench.name, bench.parameter_name, BENCH_REPEATS, median.operations, median.items, ns_per_op, min_ns_per_op, items_per_sec);
+		fflush(stream);
+	}
+
+	if (stream != stdout)
+		fclose(stream);
+	return 0;
+}
@@ -18,6 +18,7 @@
 #include <dirent.h>
 #include <sys/types.h>
 #include <string.h>
+#include <unistd.h>
 #include <iostream>
 #include <vector>
 #include <algorithm>
@@ -34,13 +35,17 @@ using namespace ssd;
  * 4. Create a report with shows the differences in response time using CDF's.
  *
  * Test assumes a 6GB SSD, with Block-size 64 and Page size 2048 bytes.
+ *
+ * Usage: bimodal [snapshot file]
+ * The first run with a snapshot file saves the device after step 1 to it,
+ * later runs restore the device from it instead of writing it again.
  */
 
 int main(int argc, char **argv){
 
 //	long vaddr;
 
-	double arrive_time;
+	double arrive_time = 0;
 
 	load_config();
 	print_config(NULL);
@@ -109,17 +114,33 @@ int main(int argc, char **argv){
 
 	// 1. Write random to the size of the device
 	srand(1);
+	const char *snapshotFile = argc > 1 ? argv[1] : NULL;
 	double afterFormatStartTime = 0;
-	//for (int i=0; i<preIO/3*2;i++)
-	for (int i=0; i<preIO*1.1;i++)
-	//for (int i=0; i<700000;i++)
+	if (snapshotFile != NULL && access(snapshotFile, F_OK) == 0)
 	{
-		long int r = random()%preIO;
-		double d = ssd.event_arrive(WRITE, r, 1, afterFormatStartTime);
-		afterFormatStartTime += d;
+		afterFormatStartTime = ssd.load_snapshot(snapshotFile);
+		printf("Restored the startup writes from %s.\n", snapshotFile);
 
-		if (i % 10000 == 0)
-			printf("Wrote %i %f\n", i,d );
+		// Later steps draw the same random numbers as after the writes.
+		for (int i=0; i<preIO*1.1;i++)
+			random();
+	}
+	else
+	{
+		//for (int i=0; i<preIO/3*2;i++)
+		for (int i=0; i<preIO*1.1;i++)
+		//for (int i=0; i<700000;i++)
+		{
+			long int r = random()%preIO;
+			double d = ssd.event_arrive(WRITE, r, 1, afterFormatStartTime);
+			afterFormatStartTime += d;
+
+			if (i % 10000 == 0)
+				printf("Wrote %i %f\n", i,d );
+		}
+
+		if (snapshotFile != NULL)
+			ssd.save_snapshot(snapshotFile, afterFormatStartTime);
 	}
 
 	start_time = afterFormatStartTime;
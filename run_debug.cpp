@@ -47,10 +47,9 @@ void debug(Ssd& ssd) throw (std::invalid_argument)
 			default:
 				throw std::invalid_argument("Invalid I/O type!");
 		}
-		global_buffer = nullptr;
 		ssd.event_arrive(type, vaddr, 1, time(NULL));
 		if (type == READ)
-			std::cout << global_buffer << std::endl;
+			std::cout << ssd.get_result_buffer() << std::endl;
 	}
 }
 
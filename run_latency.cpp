@@ -0,0 +1,64 @@
+/* run_latency.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Latency merger
+ *
+ * usage: latency <latency file> [latency file ...]
+ *
+ * Merges the request latency histograms that trace writes to its latency
+ * file, for instance of runs of the same workload with different seeds or of
+ * the parts of a split trace, and prints the percentiles of all of them.
+ * Percentiles cannot be averaged, histograms can be added. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <latency file> [latency file ...]\n", argv[0]);
+		exit(-1);
+	}
+
+	Stats total;
+	for (int i = 1; i < argc; i++)
+	{
+		FILE *file = fopen(argv[i], "r");
+		if (file == NULL)
+		{
+			fprintf(stderr, "Latency error: %s: could not open latency file %s\n", __func__, argv[i]);
+			exit(FILE_ERR);
+		}
+
+		Stats run;
+		if (!run.read_latency(file))
+		{
+			fprintf(stderr, "Latency error: %s: %s is not a latency file\n", __func__, argv[i]);
+			exit(FILE_ERR);
+		}
+		fclose(file);
+		total.merge_latency(run);
+	}
+
+	printf("Merged latency of %d runs\n", argc - 1);
+	total.print_latency();
+	return 0;
+}
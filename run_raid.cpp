@@ -21,7 +21,9 @@
 
 using namespace ssd;
 
-int main()
+/* usage: raid [latency file]
+ * the latency file receives the latency histograms of the array requests */
+int main(int argc, char **argv)
 {
 	load_config();
 	print_config(NULL);
@@ -43,6 +45,19 @@ int main()
 	}
 
 	printf("Total execution time %f\n", cur_time);
+	ssd -> print_statistics();
+
+	if (argc > 1)
+	{
+		FILE *latency = fopen(argv[1], "w");
+		if (latency == NULL)
+		{
+			fprintf(stderr, "Raid error: %s: could not create latency file %s\n", __func__, argv[1]);
+			exit(FILE_ERR);
+		}
+		ssd -> write_latency(latency);
+		fclose(latency);
+	}
 
 	delete ssd;
 	return 0;
@@ -44,7 +44,7 @@ int main()
 		result = ssd -> event_arrive(WRITE, 6+i, 1, (double) 1800+(300*i), &i);
 		printf("Write time: %.20lf\tWrote: %d\n", result, i);
 		result = ssd -> event_arrive(READ, 6+i, 1, (double) 1800+(300*i));
-		printf("Read time : %.20lf\tRead : %d\n", result, *(int*) global_buffer);
+		printf("Read time : %.20lf\tRead : %d\n", result, *(int*) ssd -> get_result_buffer());
 	}
 
 	delete ssd;
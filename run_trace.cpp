@@ -0,0 +1,134 @@
+/* run_trace.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Trace driver
+ *
+ * usage: trace <trace file> [auto|uflip|msr|spc|blkparse|binary] [config file] [statistics log] [flash trace] [latency file]
+ *
+ * Replays a block trace through the discrete-event scheduler: every request
+ * is submitted at its arrival time, so requests overlap as they did when the
+ * trace was recorded.  Addresses beyond the SSD wrap around.  Traces replayed
+ * many times are best converted to binary traces with tracebin first.
+ * Interval statistics are written to the statistics log every
+ * STATS_INTERVAL, as CSV or as JSON lines for a .json or .jsonl file.
+ * The flash trace records every bus transfer and flash operation in the
+ * Chrome Trace Event format for chrome://tracing or Perfetto.
+ * The latency file receives the request latency histograms, which latency
+ * merges across runs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+struct TraceTotals
+{
+	ulong requests[2];
+	ulong pages[2];
+	double response_time[2];
+};
+
+static void trace_completed(const Event &event, void *context)
+{
+	TraceTotals *totals = (TraceTotals *) context;
+	uint type = event.get_event_type() == WRITE ? 1 : 0;
+
+	totals->requests[type]++;
+	totals->pages[type] += event.get_size();
+	totals->response_time[type] += event.get_time_taken();
+}
+
+static double wall_time(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <trace file> [auto|uflip|msr|spc|blkparse|binary] [config file] [statistics log] [flash trace] [latency file]\n", argv[0]);
+		exit(-1);
+	}
+
+	enum trace_format format = argc > 2 ? TraceReader::parse_format(argv[2]) : TRACE_AUTO;
+	if (argc > 3)
+		load_config(argv[3]);
+	else
+		load_config();
+	print_config(NULL);
+
+	if (argc > 5)
+		FlashTrace::open(argv[5]);
+	Ssd ssd;
+	TraceReader trace(argv[1], format);
+	if (argc > 4)
+		ssd.open_stats_log(argv[4]);
+	TraceTotals totals = {{0, 0}, {0, 0}, {0.0, 0.0}};
+
+	ulong pages = NUMBER_OF_ADDRESSABLE_PAGES;
+	ulong trims = 0;
+	double start = wall_time();
+	TraceRecord record;
+
+	while (trace.next(record))
+	{
+		ulong logical_address = record.logical_address % pages;
+		uint size = std::min((ulong) record.size, pages - logical_address);
+		double arrive_time = std::max(record.arrive_time, ssd.run_until(record.arrive_time));
+
+		if (record.type == TRIM)
+		{
+			ssd.submit(TRIM, logical_address, size, arrive_time, NULL, NULL, NULL, record.streamID);
+			trims++;
+		}
+		else
+			ssd.submit(record.type, logical_address, size, arrive_time, trace_completed, &totals, NULL, record.streamID);
+	}
+	double end_time = ssd.run();
+	ssd.close_stats_log();
+	FlashTrace::close();
+	double elapsed = wall_time() - start;
+
+	ulong requests = totals.requests[0] + totals.requests[1] + trims;
+	printf("Trace: %s, %lu bytes, %lu lines skipped\n", argv[1], trace.get_size(), trace.get_skipped_lines());
+	printf("Requests: %lu reads (%lu pages), %lu writes (%lu pages), %lu trims\n", totals.requests[0], totals.pages[0], totals.requests[1], totals.pages[1], trims);
+	printf("Mean response time: read %f write %f\n",
+		totals.requests[0] > 0 ? totals.response_time[0] / totals.requests[0] : 0.0,
+		totals.requests[1] > 0 ? totals.response_time[1] / totals.requests[1] : 0.0);
+	printf("Simulated time: %f\n", end_time);
+	printf("Wall clock: %f s, %f requests/s, %f MB/s of trace\n", elapsed, elapsed > 0 ? requests / elapsed : 0.0, elapsed > 0 ? trace.get_size() / elapsed / 1e6 : 0.0);
+
+	ssd.print_statistics();
+
+	if (argc > 6)
+	{
+		FILE *latency = fopen(argv[6], "w");
+		if (latency == NULL)
+		{
+			fprintf(stderr, "Trace error: %s: could not create latency file %s\n", __func__, argv[6]);
+			exit(FILE_ERR);
+		}
+		ssd.write_latency(latency);
+		fclose(latency);
+	}
+	return 0;
+}
@@ -0,0 +1,56 @@
+/* run_tracebin.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Trace converter
+ *
+ * usage: tracebin <trace file> <binary trace file> [auto|uflip|msr|spc|blkparse] [config file]
+ *
+ * Converts a text trace to a binary trace, which TraceReader replays without
+ * parsing.  Addresses are converted to pages of PAGE_SIZE bytes, so convert
+ * with the page size the trace will be replayed with. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <trace file> <binary trace file> [auto|uflip|msr|spc|blkparse] [config file]\n", argv[0]);
+		exit(-1);
+	}
+
+	enum trace_format format = argc > 3 ? TraceReader::parse_format(argv[3]) : TRACE_AUTO;
+	if (argc > 4)
+		load_config(argv[4]);
+	else
+		load_config();
+
+	TraceReader trace(argv[1], format);
+	TraceWriter output(argv[2]);
+	TraceRecord record;
+
+	while (trace.next(record))
+		output.write(record);
+	output.close();
+
+	printf("Converted %lu requests, %lu lines skipped\n", output.get_records(), trace.get_skipped_lines());
+	return 0;
+}
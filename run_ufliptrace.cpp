@@ -29,14 +29,8 @@ using namespace ssd;
 
 int main(int argc, char **argv){
 
-	long vaddr;
-	ssd::uint queryTime;
-	char ioPatternType; // (S)equential or (R)andom
-	char ioType; // (R)ead or (W)rite
-	double arrive_time;
-	int ioSize;
-
-	char line[80];
+	TraceRecord record;
+	double arrive_time = 0;
 
 	double afterFormatStartTime = 0;
 
@@ -109,11 +103,7 @@ int main(int argc, char **argv){
 		char *filename = NULL;
 		asprintf(&filename, "%s%s", argv[1], files[i].c_str());
 
-		FILE *trace = NULL;
-		if((trace = fopen(filename, "r")) == NULL){
-			printf("File was moved or access was denied.\n");
-			exit(-1);
-		}
+		TraceReader trace(filename, TRACE_UFLIP);
 
 		printf("-__- %s -__-\n", files[i].c_str());
 
@@ -136,14 +126,16 @@ int main(int argc, char **argv){
 		}
 
 		/* first go through and write to all read addresses to prepare the SSD */
-		while(fgets(line, 80, trace) != NULL){
-			sscanf(line, "%c; %c; %li; %u; %i; %lf", &ioPatternType, &ioType, &vaddr, &queryTime, &ioSize, &arrive_time);
+		while (trace.next(record)) {
+			long vaddr = record.logical_address;
+			int ioSize = record.size;
+			arrive_time = record.arrive_time;
 
 			//printf("%li %c %c %li %u %lf %lf %li\n", ++cnt, ioPatternType, ioType, vaddr, queryTime, arrive_time, start_time+arrive_time);
 
 			double local_loop_time = 0;
 
-			if (ioType == 'R')
+			if (record.type == READ)
 			{
 				for (int i=0;i<ioSize;i++)
 				{
@@ -153,7 +145,7 @@ int main(int argc, char **argv){
 
 
 			}
-			else if(ioType == 'W')
+			else if (record.type == WRITE)
 			{
 				for (int i=0;i<ioSize;i++)
 				{
@@ -166,8 +158,6 @@ int main(int argc, char **argv){
 
 			arrive_time += local_loop_time;
 		}
-
-		fclose(trace);
 	}
 
 	printf("Pre write done------------------------------\n");
@@ -197,11 +187,7 @@ int main(int argc, char **argv){
 		char *filename = NULL;
 		asprintf(&filename, "%s%s", argv[1], files[i].c_str());
 
-		FILE *trace = NULL;
-		if((trace = fopen(filename, "r")) == NULL){
-			printf("File was moved or access was denied.\n");
-			exit(-1);
-		}
+		TraceReader trace(filename, TRACE_UFLIP);
 
 		fprintf(logFile, "%s;", files[i].c_str());
 
@@ -234,14 +220,16 @@ int main(int argc, char **argv){
 		}
 
 		/* first go through and write to all read addresses to prepare the SSD */
-		while(fgets(line, 80, trace) != NULL){
-			sscanf(line, "%c; %c; %li; %u; %i; %lf", &ioPatternType, &ioType, &vaddr, &queryTime, &ioSize, &arrive_time);
+		while (trace.next(record)) {
+			long vaddr = record.logical_address;
+			int ioSize = record.size;
+			arrive_time = record.arrive_time;
 
 			//printf("%li %c %c %li %u %lf %lf %li\n", ++cnt, ioPatternType, ioType, vaddr, queryTime, arrive_time, start_time+arrive_time);
 
 			double local_loop_time = 0;
 
-			if (ioType == 'R')
+			if (record.type == READ)
 			{
 				for (int i=0;i<ioSize;i++)
 				{
@@ -251,7 +239,7 @@ int main(int argc, char **argv){
 
 				read_time += local_loop_time;
 			}
-			else if(ioType == 'W')
+			else if (record.type == WRITE)
 			{
 				for (int i=0;i<ioSize;i++)
 				{
@@ -270,7 +258,6 @@ int main(int argc, char **argv){
 		fprintf(logFile, "%lu;%f;%lu;%f;%lu;%f;", num_reads, read_time, num_writes, write_time, num_reads+num_writes, read_time+write_time);
 		ssd.write_statistics(logFile);
 
-		fclose(trace);
 
 
 	}
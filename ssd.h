@@ -27,15 +27,17 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <assert.h>
 #include <vector>
 #include <queue>
 #include <map>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/identity.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/member.hpp>
-#include <boost/multi_index/global_fun.hpp>
-#include <boost/multi_index/random_access_index.hpp>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
  
 #ifndef _SSD_H
 #define _SSD_H
@@ -49,6 +51,10 @@ namespace ssd {
 /* Uncomment to disable asserts for production */
 #define NDEBUG
 
+/* Uncomment to build the simulator with self-profiling, see Profiler
+ * (make PROFILE=1 defines it as well) */
+//#define SSD_PROFILE
+
 
 /* some obvious typedefs for laziness */
 typedef unsigned int uint;
@@ -68,6 +74,16 @@ void print_config(FILE *stream);
 extern const double RAM_READ_DELAY;
 extern const double RAM_WRITE_DELAY;
 
+/* Ram class write buffer:
+ * 	number of pages the controller buffers in RAM (0 disables the buffer)
+ * 	eviction policy (see enum buffer_policy)
+ * 	number of least recently used pages CFLRU searches for a clean victim
+ * 	idle time after which buffered dirty pages are flushed (0 disables) */
+extern const uint RAM_BUFFER_SIZE;
+extern const uint RAM_BUFFER_POLICY;
+extern const uint RAM_BUFFER_CLEAN_WINDOW;
+extern const double RAM_BUFFER_IDLE_FLUSH;
+
 /* Bus class:
  * 	delay to communicate over bus
  * 	max number of connected devices allowed
@@ -90,8 +106,12 @@ extern const uint SSD_SIZE;
 extern const uint PACKAGE_SIZE;
 
 /* Die class:
- * 	number of Planes per Die (size) */
+ * 	number of Planes per Die (size)
+ * 	issue operations on sibling planes as one multi-plane operation
+ * 	pipeline programs and reads through the plane cache register */
 extern const uint DIE_SIZE;
+extern const bool MULTI_PLANE_ENABLE;
+extern const bool CACHE_MODE_ENABLE;
 
 /* Plane class:
  * 	number of Blocks per Plane (size)
@@ -172,6 +192,12 @@ extern const uint FAST_LOG_PAGE_LIMIT;
  */
 extern const uint CACHE_DFTL_LIMIT;
 
+/*
+ * Number of least recently used CMT entries considered together on eviction,
+ * at least 1.
+ */
+extern const uint CACHE_DFTL_EVICT_WINDOW;
+
 /*
  * Parallelism mode
  */
@@ -192,14 +218,16 @@ extern const uint NUMBER_OF_OVERPROVISIONING_BLOCKS; //Yoohyuk Lim
 extern const uint RAID_NUMBER_OF_PHYSICAL_SSDS;
 
 /* Yoohyuk Lim
- * Raid level */
+ * Raid level (0, 5 or 6) */
 extern const uint RAID_LEVEL;
 
-/*
- * Memory area to support pages with data.
- */
-extern void *page_data;
-extern void *global_buffer;
+/* RAID chunk size in pages and number of threads simulating the SSDs */
+extern const uint RAID_CHUNK_SIZE;
+extern const uint RAID_THREADS;
+
+/* Length of the intervals of the interval statistics log in simulator time
+ * units, see Ssd::open_stats_log */
+extern const double STATS_INTERVAL;
 
 /* Enumerations to clarify status integers in simulation
  * Do not use typedefs on enums for reader clarity */
@@ -222,8 +250,10 @@ enum block_state{FREE, ACTIVE, INACTIVE};
  * 	erase - erase block at address (all pages in block are erased - 
  * 	                                page states set to empty)
  * 	merge - move valid pages from block at address (page state set to invalid)
- * 	           to free pages in block at merge_address */
-enum event_type{READ, WRITE, ERASE, MERGE, TRIM};
+ * 	           to free pages in block at merge_address
+ * 	trim  - discard data at address
+ * 	flush - write all pages buffered in the controller RAM to flash */
+enum event_type{READ, WRITE, ERASE, MERGE, TRIM, FLUSH};
 
 /* General return status
  * return status for simulator operations that only need to provide general
@@ -243,7 +273,7 @@ enum address_valid{NONE, PACKAGE, DIE, PLANE, BLOCK, PAGE};
  * it should work with.
  * the block types are log, data and map (Directory map usually)
  */
-enum block_type {LOG, DATA, LOG_SEQ};
+enum block_type {LOG, DATA, LOG_SEQ, MAP};
 
 /* Yoohyuk Lim
  * Block cell types
@@ -258,6 +288,23 @@ enum block_cell_type {MLC, SLC, CELL_TYPE_NUM};
  */
 enum ftl_implementation {IMPL_PAGE, IMPL_BAST, IMPL_FAST, IMPL_DFTL, IMPL_BIMODAL};
 
+/* Write buffer eviction policies
+ * 	lru   - evict the least recently used page
+ * 	cflru - clean-first LRU, evict a clean page from the least recently used
+ * 	        RAM_BUFFER_CLEAN_WINDOW pages if there is one
+ * 	bplru - block padding LRU, pages are kept in LRU order per logical block
+ * 	        and a whole block is written back at once */
+enum buffer_policy {BUFFER_LRU, BUFFER_CFLRU, BUFFER_BPLRU};
+
+/* Block trace formats understood by TraceReader
+ * 	uflip    - "pattern; R|W; page; query time; pages; arrive time"
+ * 	msr      - MSR Cambridge CSV: "timestamp,host,disk,Read|Write,offset,size,response"
+ * 	spc      - SNIA/SPC (UMass) CSV: "asu,lba,size,r|w,timestamp"
+ * 	blkparse - default blkparse text output, queue (Q) actions only
+ * 	binary   - fixed width records written by TraceWriter, see TraceFileHeader
+ * TRACE_AUTO picks the format from the first line of the trace. */
+enum trace_format {TRACE_AUTO, TRACE_UFLIP, TRACE_MSR, TRACE_SPC, TRACE_BLKPARSE, TRACE_BINARY};
+
 
 #define BOOST_MULTI_INDEX_ENABLE_SAFE_MODE 1
 
@@ -272,9 +319,10 @@ enum ftl_implementation {IMPL_PAGE, IMPL_BAST, IMPL_FAST, IMPL_DFTL, IMPL_BIMODA
 class Address;
 class Stats;
 class Event;
+class Event_pool;
+class Timeline;
 class Channel;
 class Bus;
-class Page;
 class Block;
 class Plane;
 class Die;
@@ -292,7 +340,19 @@ class FtlImpl_BDftl;
 
 class Ram;
 class Controller;
+class Scheduler;
+class StatsLog;
+class FlashTrace;
+class Profiler;
+class Benchmark;
 class Ssd;
+class TraceReader;
+class TraceWriter;
+class Snapshot;
+
+/* Completion callback for requests submitted through Ssd::submit
+ * 	called once the simulation reaches the finish time of the request */
+typedef void (*event_callback)(const Event &event, void *context);
 
 
 
@@ -330,6 +390,36 @@ public:
 	ulong get_linear_address() const;
 };
 
+/* Log-linear latency histogram in the style of HdrHistogram.  Values are
+ * counted in units of HISTOGRAM_UNIT; below 2 * HISTOGRAM_SUB_BUCKETS units
+ * every unit has its own bucket and above that every power of two is split
+ * into HISTOGRAM_SUB_BUCKETS buckets, so any value is known to within about
+ * 1.5%.  Histograms of the same values can be merged, also across runs
+ * through write and read. */
+class Histogram
+{
+public:
+	Histogram(void);
+	void record(double value);
+	void merge(const Histogram &other);
+	void reset(void);
+	ulong get_count(void) const;
+	double get_mean(void) const;
+	double get_max(void) const;
+	double percentile(double percent) const;
+	void write(FILE *stream) const;
+	bool read(FILE *stream);
+	void snapshot(Snapshot &snapshot);
+private:
+	static uint bucket(ulong units);
+	static double bucket_limit(uint bucket);
+
+	std::vector<ulong> counts;
+	ulong count;
+	double sum;
+	double max;
+};
+
 class Stats
 {
 public:
@@ -375,6 +465,19 @@ public:
 	long numMemoryRead;
 	long numMemoryWrite;
 
+	// Controller write buffer
+	long numBufferReadHits;
+	long numBufferWriteHits;
+	long numBufferWriteBacks;
+	long numBufferFlushes;
+
+	// Request latency per stream and request type (read, write, trim)
+	std::vector<Histogram> latency;
+
+	void record_latency(enum event_type type, uint streamID, double time);
+	void merge_latency(const Stats &other);
+	Histogram get_latency(enum event_type type) const;
+
 	// Advance statictics
 	double translation_overhead() const;
 	double variance_of_io() const;
@@ -384,10 +487,14 @@ public:
 	Stats(void);
 
 	void print_statistics();
+	void print_latency();
 	void reset_statistics();
 	void write_statistics(FILE *stream);
+	void write_latency(FILE *stream);
+	bool read_latency(FILE *stream);
 	void write_custom_stat(FILE *stream); // Yoohyuk Lim
 	void write_header(FILE *stream);
+	void snapshot(Snapshot &snapshot);
 private:
 	void reset();
 };
@@ -404,6 +511,9 @@ public:
 	Address address;
 	int numPages;
 
+	// Position of its logical block in the BAST log_lbns list
+	uint index;
+
 	LogPageBlock *next;
 
 	bool operator() (const ssd::LogPageBlock& lhs, const ssd::LogPageBlock& rhs) const;
@@ -446,6 +556,7 @@ public:
 	double incr_bus_wait_time(double time);
 	double incr_time_taken(double time_incr);
 	void print(FILE *stream = stdout);
+	friend class Event_pool;
 private:
 	double start_time;
 	double time_taken;
@@ -465,6 +576,80 @@ private:
     uint streamID; //Yoohyuk Lim
 };
 
+/* Slab allocator for Events
+ * Each Ssd keeps a pool of Events so that the per-page request path does not
+ * allocate from the heap.  Events are recycled through a free list linked with
+ * the Event's next pointer, and whole event chains can be released at once. */
+class Event_pool
+{
+public:
+	Event_pool(void);
+	~Event_pool(void);
+	Event *alloc(enum event_type type, ulong logical_address, uint size, double start_time, uint streamID = STREAMID_DEFAULT);
+	void release(Event *event);
+	void release_list(Event *list);
+	uint get_in_use(void) const;
+private:
+	void grow(void);
+	Event *free_events;
+	std::vector<Event *> slabs;
+	uint in_use;
+};
+
+/* Busy timeline of a shared resource
+ * Keeps the reservations (lock and unlock times) that have not expired and
+ * schedules a new reservation at the earliest place it fits: before the first
+ * reservation, in the first long enough gap, or after the last reservation.
+ * Reservations are kept in a treap ordered by lock time that also tracks the
+ * largest gap in each subtree, so expiry, gap search and insertion take
+ * O(log n). */
+class Timeline
+{
+public:
+	Timeline(void);
+	~Timeline(void);
+	double lock(double now, double start_time, double duration);
+	double ready_time(void) const;
+	uint size(void) const;
+	void snapshot(Snapshot &snapshot);
+private:
+	struct Node {
+		double lock_time;
+		double unlock_time;
+		double gap;
+		double max_gap;
+		uint priority;
+		Node *left;
+		Node *right;
+	};
+
+	void expire(double now);
+	static void collect(const Node *node, std::vector<double> &times);
+	static Node *find_gap(Node *node, double duration);
+	static Node *find_gap_after(Node *node, double start_time, double duration);
+	void insert(double lock_time, double unlock_time);
+	static void split_locked(Node *node, double lock_time, Node *&left, Node *&right);
+	static void split_unlocked(Node *node, double unlock_time, Node *&left, Node *&right);
+	static Node *merge(Node *left, Node *right);
+	static void set_last_gap(Node *node, double lock_time);
+	static void update(Node *node);
+	uint next_priority(void);
+	Node *alloc(void);
+	void release(Node *node);
+
+	Node *root;
+	Node *free_nodes;
+	std::vector<Node *> slabs;
+	uint entries;
+	uint seed;
+
+	// Stores the highest unlock_time of all reservations.
+	double ready_at;
+
+	// Stores the highest unlock_time of the expired reservations.
+	double expired_at;
+};
+
 /* Single bus channel
  * Simulate multiple devices on 1 bus channel with variable bus transmission
  * durations for data and control delays with the Channel class.  Provide the 
@@ -479,20 +664,13 @@ class Channel
 public:
 	Channel(double ctrl_delay = BUS_CTRL_DELAY, double data_delay = BUS_DATA_DELAY, uint table_size = BUS_TABLE_SIZE, uint max_connections = BUS_MAX_CONNECT);
 	~Channel(void);
-	enum status lock(double start_time, double duration, Event &event);
+	enum status lock(double now, double start_time, double duration, Event &event);
 	enum status connect(void);
 	enum status disconnect(void);
 	double ready_time(void);
+	void snapshot(Snapshot &snapshot);
 private:
-	void unlock(double current_time);
-
-	struct lock_times {
-		double lock_time;
-		double unlock_time;
-	};
-
-	static bool timings_sorter(lock_times const& lhs, lock_times const& rhs);
-	std::vector<lock_times> timings;
+	Timeline timings;
 
 	uint table_entries;
 	uint selected_entry;
@@ -500,9 +678,6 @@ private:
 	uint max_connections;
 	double ctrl_delay;
 	double data_delay;
-
-	// Stores the highest unlock_time in the vector timings list.
-	double ready_at;
 };
 
 /* Multi-channel bus comprised of Channel class objects
@@ -518,11 +693,12 @@ class Bus
 public:
 	Bus(uint num_channels = SSD_SIZE, double ctrl_delay = BUS_CTRL_DELAY, double data_delay = BUS_DATA_DELAY, uint table_size = BUS_TABLE_SIZE, uint max_connections = BUS_MAX_CONNECT);
 	~Bus(void);
-	enum status lock(uint channel, double start_time, double duration, Event &event);
+	enum status lock(uint channel, double now, double start_time, double duration, Event &event);
 	enum status connect(uint channel);
 	enum status disconnect(uint channel);
 	Channel &get_channel(uint channel);
 	double ready_time(uint channel);
+	void snapshot(Snapshot &snapshot);
 private:
 	uint num_channels;
 	Channel * const channels;
@@ -530,33 +706,18 @@ private:
 
 
 
-/* The page is the lowest level data storage unit that is the size unit of
- * requests (events).  Pages maintain their state as events modify them. */
-class Page 
-{
-public:
-	Page(const Block &parent, double read_delay = PAGE_READ_DELAY, double write_delay = PAGE_WRITE_DELAY);
-	~Page(void);
-	enum status _read(Event &event);
-	enum status _write(Event &event);
-	const Block &get_parent(void) const;
-	enum page_state get_state(void) const;
-	void set_state(enum page_state state);
-    void set_delayes(double read_delay, double write_delay); //Yoohyuk Lim
-private:
-	enum page_state state;
-	const Block &parent;
-	double read_delay;
-	double write_delay;
-};
-
 /* The block is the data storage hardware unit where erases are implemented.
- * Blocks maintain wear statistics for the FTL. */
+ * Blocks maintain wear statistics for the FTL.  The pages, the size unit of
+ * requests (events), are kept by the block as packed page states. */
 class Block 
 {
 public:
 	long physical_address;
 	uint pages_invalid;
+	// Links in the Block_manager bucket of blocks with as many invalid pages
+	uint cost_bucket;
+	Block *cost_prev;
+	Block *cost_next;
     //Yoohyuk Lim
 	Block(const Plane &parent,
             uint size              = BLOCK_SIZE,
@@ -579,6 +740,8 @@ public:
 	double get_modification_time(void) const;
 	ulong get_erases_remaining(void) const;
 	uint get_size(void) const;
+	uint count_pages(enum page_state state) const;
+	uint find_page(enum page_state state, uint page = 0) const;
 	enum status get_next_page(Address &address) const;
 	void invalidate_page(uint page);
 	long get_physical_address(void) const;
@@ -588,11 +751,16 @@ public:
     block_cell_type get_cell_type(void) const;
     void set_cell_type(block_cell_type ctype);
 	void print_status(void);
+	void snapshot(Snapshot &snapshot);
 
 private:
+	void set_state(uint page, enum page_state state);
+	ulong page_mask(uint word) const;
 	uint size;
-	Page * const data;
+	uint words;
+	ulong * const data;
 	const Plane &parent;
+	Block_manager &manager;
 	uint pages_valid;
 	uint parity_page; // Yoohyuk Lim
 	uint data_page; // Yoohyuk Lim
@@ -604,6 +772,10 @@ private:
 
 	block_type btype;
     block_cell_type ctype; //Yoohyuk Lim
+
+	/* delays of every page of the block, which depend on its cell type */
+	double read_delay;
+	double write_delay;
 };
 
 /* The plane is the data storage hardware unit that contains blocks.
@@ -631,11 +803,16 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	double lock(double now, double start_time, double duration);
+	double ready_time(void) const;
+	void snapshot(Snapshot &snapshot);
 private:
 	void update_wear_stats(void);
 	enum status get_next_page(block_cell_type ctype);
+	Block *get_block(uint block);
+	static uint default_block_size(void);
 	uint size;
-	Block * const data;
+	Block ** const data;
 	const Die &parent;
 	uint least_worn;
 	ulong erases_remaining;
@@ -644,10 +821,16 @@ private:
 	double reg_write_delay;
 	Address next_page;
 	uint free_blocks;
+	Timeline timeline;
+	long physical_address;
 };
 
 /* The die is the data storage hardware unit that contains planes and is a flash
- * chip.  Dies maintain wear statistics for the FTL. */
+ * chip.  Dies maintain wear statistics for the FTL.  A die executes one array
+ * operation at a time, so each die keeps a busy timeline and operations on a
+ * busy die wait for it; the planes keep their own timelines of the array
+ * operations they take part in.  With multi-plane operations enabled, the
+ * same operation on sibling planes shares one slot of the die's timeline. */
 class Die 
 {
 public:
@@ -670,8 +853,12 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	double ready_time(void) const;
+	void snapshot(Snapshot &snapshot);
 private:
 	void update_wear_stats(const Address &address);
+	double schedule(Event &event, uint plane, double issue_time, double time_taken);
+	bool joins_operation(const Event &event, uint plane, double issue_time, double duration) const;
 	uint size;
 	Plane * const data;
 	const Package &parent;
@@ -679,6 +866,15 @@ private:
 	uint least_worn;
 	ulong erases_remaining;
 	double last_erase_time;
+	Timeline timeline;
+
+	/* last array operation reserved on the timeline, which operations on
+	 * other planes may join as a multi-plane operation */
+	enum event_type op_type;
+	uint op_page;
+	ulong op_planes;
+	double op_start;
+	double op_duration;
 };
 
 /* The package is the highest level data storage hardware unit.  While the
@@ -706,6 +902,7 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	void snapshot(Snapshot &snapshot);
 private:
 	void update_wear_stats (const Address &address);
 	uint size;
@@ -752,23 +949,24 @@ public:
 	bool is_log_full();
 	void erase_and_invalidate(Event &event, Address &address, block_type btype);
 	int get_num_free_blocks();
+	void stripe_dies(void);
 
 	// Used to update GC on used pages in blocks.
 	void update_block(Block * b);
-	
-	void add_to_free_list(Block *b); // Yoohyuk Lim
-
-	// Singleton
-	static Block_manager *instance();
-	static void instance_initialize(FtlParent *ftl);
-	static Block_manager *inst;
 
 	void cost_insert(Block *b);
 
 	void print_cost_status(FILE *stream); // Yoohyuk Lim
 
+	void snapshot(Snapshot &snapshot);
+
+	// Times victim selection, see run_bench.cpp
+	friend class Benchmark;
+
 private:
 	void get_page_block(Address &address, Event &event);
+	ulong interleave_blocks(ulong block) const;
+	std::vector<long>::iterator next_free_block(void);
 	static bool block_comparitor_simple (Block const *x,Block const *y);
 
 	FtlParent *ftl;
@@ -776,6 +974,9 @@ private:
 	ulong data_active[CELL_TYPE_NUM]; //Yoohyuk Lim
 	ulong log_active;
 	ulong logseq_active;
+	ulong map_active;
+
+	bool die_striping;
 
 	ulong max_log_blocks;
 	ulong max_blocks;
@@ -786,22 +987,20 @@ private:
     uint block_size; //Yoohyuk Lim
 
 	// Cost/Benefit priority queue.
-	typedef boost::multi_index_container<
-			Block*,
-			boost::multi_index::indexed_by<
-				boost::multi_index::random_access<>,
-				boost::multi_index::ordered_non_unique<BOOST_MULTI_INDEX_MEMBER(Block,uint,pages_invalid) >
-		  >
-		> active_set;
-
-	typedef active_set::nth_index<0>::type ActiveBySeq;
-	typedef active_set::nth_index<1>::type ActiveByCost;
+	// Blocks are bucketed by their number of invalid pages, the block moved
+	// into a bucket last comes first, so greedy victims are found in O(1).
+	std::vector<Block*> cost_buckets;
+	uint max_cost_bucket;
 
-	active_set active_cost;
+	void cost_link(Block *b);
+	void cost_unlink(Block *b);
+	Block *first_victim();
+	Block *next_victim(const Block *b) const;
+	Block *skip_open_blocks(Block *b) const;
 
 	// Usual block lists
 	std::vector<Block*> active_list;
-	std::vector<Block*> free_list;
+	std::vector<long> free_list; // physical addresses, blocks may not exist yet
     std::vector<Block*> invalid_list;
 
 	// Counter for returning the next free page.
@@ -820,6 +1019,9 @@ private:
 	bool inited;
 
 	bool out_of_blocks;
+
+	// Guards insert_events against reentry from blocks it allocates
+	bool collecting;
 };
 
 class FtlParent
@@ -836,6 +1038,10 @@ public:
 	virtual void print_ftl_statistics(FILE *stream); // Yoohyuk Lim
 	virtual void print_ftl_statistics();
 
+	// Saves or restores the mapping state, see Ssd::save_snapshot
+	virtual void snapshot(Snapshot &snapshot);
+	void snapshot_block(Snapshot &snapshot, Block *&block);
+
 	friend class Block_manager;
 
 	ulong get_erases_remaining(const Address &address) const;
@@ -845,8 +1051,12 @@ public:
 	Block *get_block_pointer(const Address & address);
 
 	Address resolve_logical_address(unsigned int logicalAddress);
+	Block_manager &get_block_manager(void);
 protected:
 	Controller &controller;
+
+	// Blocks of the Ssd the FTL manages
+	Block_manager manager;
 };
 
 class FtlImpl_Page : public FtlParent
@@ -857,11 +1067,30 @@ public:
 	enum status read(Event &event);
 	enum status write(Event &event);
 	enum status trim(Event &event);
+	void cleanup_block(Event &event, Block *block);
+	void print_ftl_statistics(FILE *stream);
+	void print_ftl_statistics();
+	void snapshot(Snapshot &snapshot);
 private:
-	ulong currentPage;
-	ulong numPagesActive;
-	bool *trim_map;
-	long *map;
+	long get_free_page(Event &event, bool insert_events);
+	long next_page(long &page, Event &event);
+
+	static const uint32_t UNMAPPED = UINT32_MAX;
+
+	// Mapping tables, logical to physical page and back
+	uint32_t *map;
+	uint32_t *reverse_map;
+
+	// Open blocks, one per die (per plane with multi-plane operations),
+	// written round robin
+	uint openWidth;
+	uint openNext;
+	long *openPage;
+
+	// Open block for pages moved by garbage collection
+	long gcPage;
+
+	uint block_size;
 };
 
 class FtlImpl_Bast : public FtlParent
@@ -873,7 +1102,12 @@ public:
 	enum status write(Event &event);
 	enum status trim(Event &event);
 private:
-	std::map<long, LogPageBlock*> log_map;
+	// Log block of each logical block, NULL when it has none
+	LogPageBlock **log_map;
+
+	// Logical blocks that have a log block, merge victims are picked from them
+	long *log_lbns;
+	uint log_count;
 
 	long *data_list;
 
@@ -902,7 +1136,15 @@ public:
 private:
 	void initialize_log_pages();
 
-	std::map<long, LogPageBlock*> log_map;
+	// Latest copy of a logical page in the RW log blocks
+	struct LogPage {
+		LogPageBlock *block;
+		int page;
+	};
+
+	std::unordered_map<long, LogPage> log_hash;
+
+	void forget_logical_block(long logicalBlockAddress);
 
 	long *data_list;
 	bool *pin_list;
@@ -938,48 +1180,72 @@ public:
 	virtual enum status read(Event &event) = 0;
 	virtual enum status write(Event &event) = 0;
 	virtual enum status trim(Event &event) = 0;
+	void snapshot(Snapshot &snapshot);
+
+	// Times resolve_mapping, see run_bench.cpp
+	friend class Benchmark;
 protected:
-	struct MPage {
-		long vpn;
-		long ppn;
-		double create_ts;
-		double modified_ts;
-		double last_visited_time;
-		bool cached;
-
-		MPage(long vpn);
+	/* Cached Mapping Table entry. Entries are chained by logical page in
+	 * cmt_hash and linked in LRU order, most recently used at cmt_head.
+	 * An entry is dirty while dirty_gen matches the generation of its
+	 * translation page, so writing a translation page back cleans all of
+	 * its cached entries at once. */
+	struct CmtEntry {
+		uint32_t lpn;
+		uint32_t hash_next;
+		uint32_t lru_prev;
+		uint32_t lru_next;
+		uint32_t dirty_gen;
 	};
 
+	static const uint32_t UNMAPPED = UINT32_MAX;
+	static const uint32_t CMT_NIL = UINT32_MAX;
+
+	// Mapping tables, logical to physical page and back
+	uint32_t *trans_map;
+	uint32_t *reverse_trans_map;
+
+	// Global Translation Directory, translation page to physical page
+	uint32_t *gtd;
+	uint numTranslationPages;
+
+	// Write back generation and number of dirty cached entries per
+	// translation page
+	uint32_t *tpage_gen;
+	uint32_t *tpage_dirty;
+
+	// Cached Mapping Table
+	std::vector<CmtEntry> cmt_entries;
+	uint32_t *cmt_hash;
+	uint32_t cmt_hash_mask;
+	uint32_t cmt_free;
+	uint32_t cmt_head;
+	uint32_t cmt_tail;
 	long int cmt;
 
-	static double mpage_last_visited_time_compare(const MPage& mpage);
-
-	typedef boost::multi_index_container<
-		FtlImpl_DftlParent::MPage,
-			boost::multi_index::indexed_by<
-		    // sort by MPage::operator<
-    			boost::multi_index::random_access<>,
-
-    			// Sort by last visited time
-    			boost::multi_index::ordered_non_unique<boost::multi_index::global_fun<const FtlImpl_DftlParent::MPage&,double,&FtlImpl_DftlParent::mpage_last_visited_time_compare> >
-		  >
-		> trans_set;
-
-	typedef trans_set::nth_index<0>::type MpageByID;
-	typedef trans_set::nth_index<1>::type MpageByLastVisited;
-
-	trans_set trans_map;
-	long *reverse_trans_map;
-
 	void consult_GTD(long dppn, Event &event);
-	void reset_MPage(FtlImpl_DftlParent::MPage &mpage);
 
 	void resolve_mapping(Event &event, bool isWrite);
-	void update_translation_map(FtlImpl_DftlParent::MPage &mpage, long ppn);
-
-	bool lookup_CMT(long dlpn, Event &event);
+	long get_mapping(long dlpn) const;
+	void update_translation_map(long dlpn, long ppn);
+	void migrate_mapping(long dlpn, long ppn);
+
+	uint32_t lookup_CMT(long dlpn, Event &event);
+	uint32_t cmt_find(long dlpn) const;
+	uint32_t cmt_insert(long dlpn, bool recent);
+	void cmt_remove(uint32_t entry);
+	void cmt_link(uint32_t entry, bool recent);
+	void cmt_unlink(uint32_t entry);
+	bool cmt_is_dirty(uint32_t entry) const;
+	void cmt_set_dirty(uint32_t entry);
+	void write_back_translation_page(Event &event, long dlpn);
+	void write_translation_page(Event &event, long mvpn);
+	long get_free_translation_page(Event &event);
+	bool is_translation_block_end(void);
+	void cleanup_translation_block(Event &event, Block *block);
 
     bool is_block_end(uint streamID);
+    long *next_data_page(uint streamID);
 
     long get_free_data_page(Event &event);
 	long get_free_data_page(Event &event, bool insert_events);
@@ -995,6 +1261,12 @@ protected:
 	// Current storage
 	long *currentDataPage; //Yoohyuk Lim
 	long currentTranslationPage;
+	long spareTranslationBlock;
+
+	// Open data blocks per stream, one per plane with multi-plane operations
+	uint stripeWidth;
+	long *stripePage;
+	uint *stripeNext;
     
     uint block_size; //Yoohyuk Lim
 };
@@ -1021,6 +1293,7 @@ public:
 	enum status write(Event &event);
 	enum status trim(Event &event);
 	void cleanup_block(Event &event, Block *block);
+	void snapshot(Snapshot &snapshot);
 private:
 	struct BPage {
 		uint pbn;
@@ -1045,16 +1318,80 @@ private:
 /* This is a basic implementation that only provides delay updates to events
  * based on a delay value multiplied by the size (number of pages) needed to
  * be written. */
+/* The RAM of the controller charges a delay for every page of data that moves
+ * through it and holds the controller's write buffer.  The buffer caches up
+ * to RAM_BUFFER_SIZE pages and keeps them in eviction units ordered from most
+ * to least recently used: one page per unit for LRU and CFLRU and one logical
+ * block per unit for BPLRU.  The Controller decides what is buffered and
+ * writes dirty pages back through the FTL. */
 class Ram 
 {
 public:
-	Ram(double read_delay = RAM_READ_DELAY, double write_delay = RAM_WRITE_DELAY);
+	Ram(double read_delay = RAM_READ_DELAY, double write_delay = RAM_WRITE_DELAY, uint buffer_size = RAM_BUFFER_SIZE);
 	~Ram(void);
 	enum status read(Event &event);
 	enum status write(Event &event);
+
+	static const uint32_t BUFFER_NIL = UINT32_MAX;
+
+	uint get_buffer_size(void) const;
+	uint get_buffer_used(void) const;
+	uint get_buffer_dirty(void) const;
+	uint32_t find_page(ulong lpn) const;
+	uint32_t insert_page(ulong lpn, uint streamID, bool dirty);
+	void remove_page(uint32_t page);
+	void touch_page(uint32_t page);
+	void set_dirty(uint32_t page, bool dirty);
+	bool is_dirty(uint32_t page) const;
+	ulong get_lpn(uint32_t page) const;
+	uint get_streamID(uint32_t page) const;
+	void *get_data(uint32_t page) const;
+	uint32_t get_victim(void) const;
+	uint32_t get_lru_unit(void) const;
+	uint32_t get_newer_unit(uint32_t unit) const;
+	void get_unit_pages(uint32_t unit, std::vector<uint32_t> &pages) const;
+	void snapshot(Snapshot &snapshot);
 private:
+	struct BufferPage {
+		ulong lpn;
+		uint streamID;
+		bool dirty;
+		uint32_t hash_next;
+		uint32_t unit;
+		uint32_t unit_next;
+	};
+
+	struct BufferUnit {
+		ulong key;
+		uint32_t hash_next;
+		uint32_t lru_prev;
+		uint32_t lru_next;
+		uint32_t pages;
+		uint count;
+		uint dirty;
+	};
+
+	uint32_t find_unit(ulong key) const;
+	void unit_link(uint32_t unit, bool recent);
+	void unit_unlink(uint32_t unit);
+
 	double read_delay;
 	double write_delay;
+
+	uint buffer_size;
+	uint unit_size;
+	uint used;
+	uint dirty;
+	std::vector<BufferPage> buffer_pages;
+	std::vector<BufferUnit> buffer_units;
+	std::vector<uint32_t> page_hash;
+	std::vector<uint32_t> unit_hash;
+	uint32_t hash_mask;
+	uint32_t page_free;
+	uint32_t unit_free;
+	uint32_t lru_head;
+	uint32_t lru_tail;
+	char *buffer_data;
 };
 
 /* The controller accepts read/write requests through its event_arrive method
@@ -1084,6 +1421,8 @@ public:
 	void print_ftl_statistics();
 	void print_ftl_statistics(FILE *stream); // Yoohyuk Lim
 	const FtlParent &get_ftl(void) const;
+	Block_manager &get_block_manager(void) const;
+	void snapshot(Snapshot &snapshot);
 private:
 	enum status issue(Event &event_list);
 	void translate_address(Address &address);
@@ -1097,13 +1436,264 @@ private:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	void *get_page_data(ulong page) const;
+	enum status buffer_event(Event &event);
+	enum status buffer_read(Event &event);
+	enum status buffer_write(Event &event);
+	enum status buffer_trim(Event &event);
+	enum status flush(Event &event, double end_time);
+	enum status make_room(Event &event);
+	enum status write_back(uint32_t page, Event &event);
 	Ssd &ssd;
 	FtlParent *ftl;
+
+	// Finish time of the latest request, the start of the current idle period
+	double last_finish;
+	std::vector<uint32_t> unit_pages;
+};
+
+/* Discrete-event scheduler
+ * Keeps submitted requests in a time-ordered queue (pairing heap) and services
+ * them in arrival order so that many host requests can be in flight at once.
+ * Completions are queued at their finish time and reported through the
+ * request's callback when the simulation reaches that time. */
+class Scheduler
+{
+public:
+	Scheduler(Ssd &ssd);
+	~Scheduler(void);
+	void submit(Event &event, event_callback callback, void *context);
+	double run_until(double time);
+	double run(void);
+	uint get_queue_depth(void) const;
+	double get_current_time(void) const;
+	void snapshot(Snapshot &snapshot);
+private:
+	enum entry_stage {COMPLETION, ARRIVAL};
+
+	struct Entry {
+		double time;
+		ulong sequence;
+		enum entry_stage stage;
+		Event *event;
+		event_callback callback;
+		void *context;
+		Entry *child;
+		Entry *sibling;
+	};
+
+	static bool before(const Entry *lhs, const Entry *rhs);
+	static Entry *meld(Entry *first, Entry *second);
+	static Entry *meld_pairs(Entry *list);
+	void push(Entry *entry);
+	Entry *pop(void);
+	Entry *alloc(void);
+	void release(Entry *entry);
+
+	Ssd &ssd;
+	Entry *root;
+	Entry *free_entries;
+	std::vector<Entry *> slabs;
+	ulong sequence;
+	double current_time;
+	uint in_flight;
+};
+
+/* Interval statistics log
+ * Cuts simulated time into intervals of STATS_INTERVAL and writes a line per
+ * interval while the simulation runs: request rates, bandwidth, latency,
+ * garbage collection time, write amplification, free blocks and the mapping
+ * cache hit ratio.  Requests count towards the interval they arrive in.
+ * Rates assume the simulator time unit is a microsecond, as in ssd.conf.
+ * Files ending in .json or .jsonl get JSON lines, other files CSV. */
+class StatsLog
+{
+public:
+	StatsLog(Ssd &ssd);
+	~StatsLog(void);
+	void open(const char *path, double interval);
+	void close(void);
+	bool is_open(void) const;
+	void advance(double time);
+	void record(const Event &event);
+	void rebase(void);
+private:
+	void write_interval(void);
+	void clear_interval(void);
+
+	Ssd &ssd;
+	FILE *stream;
+	bool json;
+	double interval;
+	double interval_start;
+	bool started;
+
+	// Requests and pages of the current interval per type (read, write, trim)
+	ulong requests[3];
+	ulong pages[3];
+	Histogram latency;
+
+	// Counters at the start of the current interval
+	long flash_writes;
+	double gc_time;
+	long cache_hits;
+	long cache_faults;
 };
 
+/* Flash operation trace
+ * Records bus transfers, flash reads, programs, erases and merges and the
+ * garbage collection runs of every Ssd as duration events in the Chrome
+ * Trace Event format, which chrome://tracing and Perfetto open.  Every Ssd
+ * is a process with a track per die, per bus channel and one for garbage
+ * collection, and flash operations issued by garbage collection are in the
+ * "gc" category.  Events are appended to a buffer of the simulating thread
+ * without locking; a full buffer is written out by its thread under the
+ * file lock.  Tracing is off until open is called and costs one flag test
+ * per operation while it is off. */
+class FlashTrace
+{
+public:
+	enum operation {BUS_TRANSFER, FLASH_READ, FLASH_PROGRAM, FLASH_ERASE, FLASH_MERGE, GC_RUN};
+
+	static void open(const char *path);
+	static void close(void);
+	static bool is_enabled(void) { return enabled.load(std::memory_order_relaxed); }
+	static uint new_device(void);
+	static void set_device(uint device);
+	static void begin_gc(void);
+	static void end_gc(void);
+	static void record(enum operation operation, double start, double duration, const Event &event);
+	static void record_gc(double start, double duration, uint streamID);
+private:
+	struct Record {
+		double start;
+		double duration;
+		uint8_t operation;
+		uint8_t gc;
+		uint16_t streamID;
+		uint32_t device;
+		uint32_t package;
+		uint32_t die;
+		uint32_t plane;
+		uint32_t block;
+		uint32_t page;
+		ulong logical_address;
+	};
+
+	struct Buffer {
+		std::vector<Record> records;
+		ulong generation;
+	};
+
+	static Buffer &get_buffer(void);
+	static void append(const Record &record);
+	static void flush(Buffer &buffer);
+
+	static std::atomic<bool> enabled;
+	static std::atomic<uint> devices;
+	static std::mutex lock;
+	static FILE *stream;
+	static bool first_event;
+	static ulong generation;
+	static std::vector<Buffer *> buffers;
+};
+
+/* Simulator self-profiling
+ * Measures the CPU time the simulator itself spends in its subsystems with
+ * scoped timers and counts the requests the Ssds service, to tell which
+ * change made the simulator slower.  Timers nest and a timer only counts
+ * the time outside the timers nested in it, so the FTL time is the mapping
+ * work without the flash operations it issues, and the flash operation time
+ * is without the bus scheduling.  Every thread counts in its own counters,
+ * so the time of worker threads adds up and can exceed the wall clock.
+ * Timers read the time stamp counter where there is one and the steady
+ * clock otherwise.  Without SSD_PROFILE the timers compile to nothing. */
+enum profile_section {PROFILE_FTL, PROFILE_FLASH, PROFILE_CHANNEL, PROFILE_GC, PROFILE_TRACE, PROFILE_SECTIONS};
+
+#ifdef SSD_PROFILE
+class Profiler
+{
+public:
+	class Timer
+	{
+	public:
+		Timer(enum profile_section section): section(section), children(0), parent(active)
+		{
+			active = this;
+			start = now();
+		}
+
+		~Timer(void)
+		{
+			uint64_t elapsed = now() - start;
+			active = parent;
+			if (parent != NULL)
+				parent->children += elapsed;
+			add(section, elapsed - children);
+		}
+	private:
+		enum profile_section section;
+		uint64_t start;
+		uint64_t children;
+		Timer *parent;
+	};
+
+	static void count_event(void);
+	static void reset(void);
+	static void print(FILE *stream);
+private:
+	struct Counters {
+		std::atomic<uint64_t> ticks[PROFILE_SECTIONS];
+		std::atomic<uint64_t> calls[PROFILE_SECTIONS];
+		std::atomic<uint64_t> events;
+	};
+
+	static uint64_t now(void)
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __builtin_ia32_rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/* only the owning thread writes its counters, so no atomic
+	 * read-modify-write is needed */
+	static void add(enum profile_section section, uint64_t ticks)
+	{
+		Counters &c = get_counters();
+		c.ticks[section].store(c.ticks[section].load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+		c.calls[section].store(c.calls[section].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	static Counters &get_counters(void)
+	{
+		return local != NULL ? *local : register_thread();
+	}
+
+	static Counters &register_thread(void);
+
+	static thread_local Timer *active;
+	static thread_local Counters *local;
+	static std::mutex lock;
+	static std::vector<Counters *> counters;
+	static uint64_t start_ticks;
+	static std::chrono::steady_clock::time_point start_time;
+};
+
+#define PROFILE_SCOPE(section) ssd::Profiler::Timer profile_timer(section)
+#define PROFILE_EVENT() ssd::Profiler::count_event()
+#else
+#define PROFILE_SCOPE(section)
+#define PROFILE_EVENT()
+#endif
+
 /* The SSD is the single main object that will be created to simulate a real
  * SSD.  Creating a SSD causes all other objects in the SSD to be created.  The
- * event_arrive method is where events will arrive from DiskSim. */
+ * event_arrive method is where events will arrive from DiskSim.  Requests can
+ * also be submitted to the discrete-event scheduler with submit and are then
+ * simulated with run_until or run.  The state of an idle SSD can be saved with
+ * save_snapshot and restored into a new one with load_snapshot, see Snapshot. */
 class Ssd 
 {
 public:
@@ -1114,19 +1704,33 @@ public:
 	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer);
     //Yoohyuk Lim
 	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer, uint streamID);
+	void submit(enum event_type type, ulong logical_address, uint size, double start_time, event_callback callback = NULL, void *context = NULL, void *buffer = NULL, uint streamID = STREAMID_DEFAULT);
+	double run_until(double time);
+	double run(void);
+	uint get_queue_depth(void) const;
+	double get_clock(void) const;
 	void *get_result_buffer();
 	friend class Controller;
+	friend class Scheduler;
+	friend class StatsLog;
+	friend class RaidSsd;
+	void open_stats_log(const char *path, double interval = STATS_INTERVAL);
+	void close_stats_log(void);
 	void print_statistics();
 	void reset_statistics();
 	void write_statistics(FILE *stream);
+	void write_latency(FILE *stream);
 	void write_custom_stat(FILE *stream); // Yoohyuk Lim
 	void write_header(FILE *stream);
 	const Controller &get_controller(void) const;
+	Block_manager &get_block_manager(void) const;
 	void print_cost_status(FILE *stream); // Yoohyuk Lim
 
 	void print_ftl_statistics();
 	void print_ftl_statistics(FILE *stream); // Yoohyuk Lim
 	double ready_at(void);
+	void save_snapshot(const char *path, double time = 0.0);
+	double load_snapshot(const char *path);
 private:
 	enum status read(Event &event);
 	enum status write(Event &event);
@@ -1146,16 +1750,34 @@ private:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	void *get_page_data(ulong page) const;
+	void dispatch(Event &event);
+	void account(const Event &event);
+	void snapshot(Snapshot &snapshot);
 
 	uint size;
 	Controller controller;
 	Ram ram;
 	Bus bus;
+	Event_pool event_pool;
+	Scheduler scheduler;
+	StatsLog stats_log;
+	uint trace_device;
+
+	/* latest arrival time serviced, the current time of the bus and flash
+	 * timelines */
+	double clock;
 	Package * const data;
 	ulong erases_remaining;
 	ulong least_worn;
 	double last_erase_time;
 
+	/* data of every physical page when PAGE_ENABLE_DATA is set and the data
+	 * of the page read last */
+	void *page_data;
+	ulong page_data_size;
+	void *result_buffer;
+
 	/* Yoohyuk Lim
 	 * 0 : lpn
 	 * 1 : byte size
@@ -1163,6 +1785,13 @@ private:
 	ulong event_buffer[3];
 };
 
+/* The RAID SSD combines RAID_NUMBER_OF_PHYSICAL_SSDS SSDs into one array.
+ * Pages are striped over the SSDs in chunks of RAID_CHUNK_SIZE pages and
+ * RAID-5 and RAID-6 add one and two rotating parity chunks to every stripe.
+ * A request is simulated in at most two phases: the reads of old data and
+ * parity that partial stripe writes need, then the request itself with the
+ * new parity.  The SSDs of a phase are simulated in parallel on
+ * RAID_THREADS threads and the phase takes as long as its slowest SSD. */
 class RaidSsd
 {
 public:
@@ -1171,20 +1800,267 @@ public:
 	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time);
 	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer);
 	void *get_result_buffer();
+	ulong get_capacity(void) const;
 	friend class Controller;
 	void print_statistics();
 	void reset_statistics();
 	void write_statistics(FILE *stream);
+	void write_latency(FILE *stream);
 	void write_header(FILE *stream);
 	const Controller &get_controller(void) const;
 
 	void print_ftl_statistics();
 private:
+	/* Request to one SSD of the array.  Reads that feed a parity
+	 * computation copy the page read to result. */
+	struct RaidOp {
+		enum event_type type;
+		ulong logical_address;
+		uint size;
+		void *payload;
+		uint streamID;
+		char *result;
+		double time_taken;
+	};
+
+	/* New parity of one stripe row, from the pages written to the row and,
+	 * for partial stripe writes, their old data and the old parity */
+	struct ParityRow {
+		char *parity[2];
+		char *old_parity[2];
+		uint first;
+		uint count;
+	};
+
+	struct ParityPage {
+		uint index;
+		const char *data;
+		const char *old;
+	};
+
+	uint data_member(ulong stripe, uint index) const;
+	uint parity_member(ulong stripe, uint parity) const;
+	void map_page(ulong logical_address, uint &member, ulong &member_address) const;
+	void add_op(uint phase, uint member, enum event_type type, ulong logical_address, void *payload, uint streamID, char *result);
+	char *scratch_page(void);
+	void plan_write(ulong logical_address, uint size, char *buffer);
+	void plan_trim(ulong logical_address, uint size);
+	void compute_parity(void);
+	double run_phase(uint phase, double start_time);
+	void run_member(uint member);
+	void run_worker(uint worker);
+	void worker_main(uint worker);
+
 	uint size;
 
 	Ssd *Ssds;
+	void *result_buffer;
+
+	uint members;
+	uint parity_members;
+	uint data_members;
+	ulong capacity;
+
+	// Requests of the current array request, per phase and SSD
+	std::vector<std::vector<RaidOp> > ops[2];
+	std::vector<ParityRow> parity_rows;
+	std::vector<ParityPage> parity_pages;
+	std::vector<char> scratch;
+	ulong scratch_used;
+
+	// Worker threads, the caller simulates the SSDs of worker 0
+	uint threads;
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+	ulong generation;
+	uint pending;
+	bool stopping;
+	uint phase;
+	double phase_start;
+
+	long numFullStripeWrites;
+	long numReadModifyWrites;
+	long numParityWrites;
+
+	// Latency of whole array requests, the SSDs only see their parts
+	Stats stats;
+};
+
+/* One request of a block trace, in pages and simulator time units.  uFLIP
+ * traces already address pages and their times are passed through as they
+ * are; the other formats address bytes or sectors, which are converted to the
+ * pages they touch, and their times are converted to microseconds since the
+ * first request of the trace. */
+struct TraceRecord
+{
+	enum event_type type;
+	ulong logical_address;
+	uint size;
+	double arrive_time;
+	uint streamID;
+};
 
+/* Binary trace files hold a header followed by fixed width records in host
+ * byte order.  Record times are kept as the difference to the previous
+ * record in millionths of a simulator time unit, which covers traces of
+ * about a hundred days of microseconds. */
+struct TraceFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t records;
 };
+
+struct TraceFileRecord
+{
+	int64_t time_delta;
+	uint64_t logical_address;
+	uint32_t size;
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t streamID;
+};
+
+/* Streaming reader of block traces.  The trace file is mapped into memory and
+ * cut into chunks at line boundaries.  Worker threads parse the chunks in
+ * parallel and hand the parsed records to the reading thread in trace order
+ * through a ring of chunk slots.  Each slot is owned by either the workers or
+ * the reader as told by its sequence number, so the handoff takes no locks.
+ * Lines that do not parse (headers, comments, blkparse summaries) are
+ * skipped. */
+class TraceReader
+{
+public:
+	TraceReader(const char *path, enum trace_format format = TRACE_AUTO, uint threads = 0);
+	~TraceReader(void);
+	bool next(TraceRecord &record);
+	enum trace_format get_format(void) const;
+	ulong get_size(void) const;
+	ulong get_skipped_lines(void) const;
+	static enum trace_format parse_format(const char *name);
+	static const char BINARY_MAGIC[8];
+	static const uint32_t BINARY_VERSION = 1;
+private:
+	/* Records of one chunk.  Slot i holds chunks i, i + ring_size, ...; its
+	 * sequence is 2 * chunk while the chunk is being parsed and
+	 * 2 * chunk + 1 once it is ready to be read. */
+	struct Slot {
+		std::atomic<ulong> sequence;
+		std::vector<TraceRecord> records;
+		ulong skipped;
+	};
+
+	static enum trace_format detect_format(const char *data, ulong size);
+	void open_binary(const char *path);
+	ulong detect_time_base(void) const;
+	static bool parse_line(enum trace_format format, ulong time_base, const char *line, const char *end, TraceRecord &record);
+	static bool parse_uflip(const char *line, const char *end, TraceRecord &record);
+	static bool parse_msr(ulong time_base, const char *line, const char *end, TraceRecord &record);
+	static bool parse_spc(const char *line, const char *end, TraceRecord &record);
+	static bool parse_blkparse(const char *line, const char *end, TraceRecord &record);
+	static void set_bytes(TraceRecord &record, ulong offset, ulong length);
+	ulong chunk_start(ulong chunk) const;
+	void parse_chunk(ulong chunk, Slot &slot) const;
+	void worker_main(void);
+
+	int fd;
+	const char *data;
+	ulong size;
+	enum trace_format format;
+	/* MSR timestamps do not fit a double, they are taken relative to the
+	 * first one */
+	ulong time_base;
+
+	ulong chunks;
+	uint ring_size;
+	Slot *ring;
+	std::atomic<ulong> next_chunk;
+	std::atomic<bool> stopping;
+	std::vector<std::thread> workers;
+
+	/* records of a binary trace, read in place */
+	const TraceFileRecord *binary_records;
+	ulong binary_count;
+	int64_t binary_time;
+
+	/* reading side */
+	ulong current;
+	ulong index;
+	bool started;
+	double first_time;
+	ulong skipped;
+};
+
+/* Writes binary traces for TraceReader.  The record count in the header is
+ * filled in by close, which the destructor calls. */
+class TraceWriter
+{
+public:
+	TraceWriter(const char *path);
+	~TraceWriter(void);
+	void write(const TraceRecord &record);
+	void close(void);
+	ulong get_records(void) const;
+private:
+	FILE *file;
+	ulong records;
+	int64_t last_time;
+};
+
+/* Checkpoint of the complete state of an Ssd, written by Ssd::save_snapshot
+ * and read back by Ssd::load_snapshot, to precondition a drive once and
+ * start many experiments from the same aged state.  Every class saves and
+ * restores its state in a snapshot method that serves both directions: the
+ * same calls write the members when saving and overwrite them when loading,
+ * so the two cannot drift apart.  The file is the raw state in native byte
+ * order after a header and the configuration it was taken with; it is only
+ * read back by the same build on the same kind of machine.  Snapshots are
+ * restored from a read-only mapping of the file. */
+class Snapshot
+{
+public:
+	Snapshot(const char *path, bool loading);
+	~Snapshot(void);
+	bool is_loading(void) const;
+	void transfer(void *values, ulong bytes);
+	void config(const char *name, double value);
+	void close(void);
+
+	template <typename T> void value(T &value)
+	{
+		transfer(&value, sizeof(value));
+	}
+
+	template <typename T> void array(T *values, ulong count)
+	{
+		transfer(values, count * sizeof(T));
+	}
+
+	template <typename T> void vector(std::vector<T> &values)
+	{
+		ulong count = values.size();
+		value(count);
+		if (loading)
+			values.resize(count);
+		if (count > 0)
+			array(&values[0], count);
+	}
+
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 2;
+private:
+	const char *path;
+	bool loading;
+	FILE *file;
+	int fd;
+	const char *data;
+	ulong size;
+	ulong offset;
+};
+
 } /* end namespace ssd */
 
 #endif
@@ -21,24 +21,48 @@
  * Brendan Tauras 2009-10-26
  *
  * The block is the data storage hardware unit where erases are implemented.
- * Blocks maintain wear statistics for the FTL. */
+ * Blocks maintain wear statistics for the FTL.
+ *
+ * Pages are the size unit of requests (events) but have no state besides
+ * EMPTY, VALID or INVALID, so the block keeps the page states packed two bits
+ * per page in an array of words and keeps the page delays once for the whole
+ * block.  Counting the pages in a state and finding the next page in a state
+ * work on a whole word at a time. */
 
 #include <new>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include "ssd.h"
 
 using namespace ssd;
 
+/* page states held by one word */
+#define PAGES_PER_WORD (sizeof(ulong) * 4)
+
+/* low bit of every page state in a word */
+static const ulong LOW_BITS = ~0ul / 3;
+
+/* low bit set for each page of the word that is in the given state */
+static inline ulong match_state(ulong word, enum page_state state)
+{
+	ulong diff = word ^ (LOW_BITS * (ulong) state);
+	return ~(diff | (diff >> 1)) & LOW_BITS;
+}
+
 Block::Block(const Plane &parent, uint block_size, ulong erases_remaining, double erase_delay, long physical_address, block_cell_type ctype):
 	pages_invalid(0),
 	physical_address(physical_address),
 	size(block_size),
 
-	/* use a const pointer (Page * const data) to use as an array
+	/* the block can grow to the larger cell type's size in SLC_MLC mode */
+	words(((SLC_MLC_ENABLE == true && SLC_BLOCK_SIZE > block_size ? SLC_BLOCK_SIZE : block_size) + PAGES_PER_WORD - 1) / PAGES_PER_WORD),
+
+	/* use a const pointer (ulong * const data) to use as an array
 	 * but like a reference, we cannot reseat the pointer */
-	data((Page *) malloc(block_size * sizeof(Page))),
+	data((ulong *) malloc(words * sizeof(ulong))),
 	parent(parent),
+	manager(parent.get_parent().get_parent().get_parent().get_block_manager()),
 	pages_valid(0),
 	parity_page(0), // Yoohyuk Lim
 	data_page(0), // Yoohyuk Lim
@@ -59,28 +83,22 @@ Block::Block(const Plane &parent, uint block_size, ulong erases_remaining, doubl
     ctype(ctype)
 
 {
-    uint i;
-    uint read_delay;
-    uint write_delay;
-
 	if(erase_delay < 0.0)
 	{
 		fprintf(stderr, "Block warning: %s: constructor received negative erase delay value\n\tsetting erase delay to 0.0\n", __func__);
 		erase_delay = 0.0;
 	}
 
-	/* new cannot initialize an array with constructor args so
-	 * 	malloc the array
-	 * 	then use placement new to call the constructor for each element
-	 * chose an array over container class so we don't have to rely on anything
-	 * 	i.e. STL's std::vector */
 	/* array allocated in initializer list:
-	 * data = (Page *) malloc(size * sizeof(Page)); */
+	 * data = (ulong *) malloc(words * sizeof(ulong)); */
 	if(data == NULL){
 		fprintf(stderr, "Block error: %s: constructor unable to allocate Page data\n", __func__);
 		exit(MEM_ERR);
 	}
 
+	/* all pages start EMPTY */
+	memset(data, 0, words * sizeof(ulong));
+
     /* Yoohyuk Lim
      * The base block is MLC block.
      * This can be changed to SLC block. */
@@ -91,56 +109,41 @@ Block::Block(const Plane &parent, uint block_size, ulong erases_remaining, doubl
         read_delay = PAGE_READ_DELAY;
         write_delay = PAGE_WRITE_DELAY;
     }
-    
-    for(i = 0; i < size; i++)
-	    (void) new (&data[i]) Page(*this, read_delay, write_delay);
 
 	// Creates the active cost structure in the block manager.
-	// It assumes that it is created lineary.
-	Block_manager::instance()->cost_insert(this);
-	
-	/* Yoohyuk Lim
-	 * Add the over provisioning block to free list. */
-	if (physical_address >= NUMBER_OF_ADDRESSABLE_PAGES)
-		Block_manager::instance()->add_to_free_list(this);
+	// Blocks are created when they are first used, in any order.
+	manager.cost_insert(this);
 
 	return;
 }
 
-// Yoohyuk Lim
 Block::~Block(void)
 {
 	assert(data != NULL);
-	uint i;
-	/* call destructor for each Page array element
-	 * since we used malloc and placement new */
-
-    /* In SLC & MLC mode,
-     * the block size can be shrunk accordind to its cell type.
-     * But it doesn't mean that the actual size is changed,
-     * so we should free the actual size (MLC_BLOCK_SIZE). */
-    if (SLC_MLC_ENABLE == true)
-        size = MLC_BLOCK_SIZE;
-
-	for(i = 0; i < size; i++)
-		data[i].~Page();
 	free(data);
 	return;
 }
 
 enum status Block::read(Event &event)
 {
-	assert(data != NULL);
-	return data[event.get_address().page]._read(event);
+	assert(data != NULL && event.get_address().page < size && read_delay >= 0.0);
+
+	event.incr_time_taken(read_delay);
+	return SUCCESS;
 }
 
 enum status Block::write(Event &event)
 {
-	assert(data != NULL);
-	enum status ret = data[event.get_address().page]._write(event);
+	assert(data != NULL && event.get_address().page < size && write_delay >= 0.0);
+	enum status ret = SUCCESS;
+
+	event.incr_time_taken(write_delay);
 
 	if(event.get_noop() == false)
 	{
+		assert(get_state(event.get_address().page) == EMPTY);
+		set_state(event.get_address().page, VALID);
+
 		pages_valid++;
 		state = ACTIVE;
 		modification_time = event.get_start_time();
@@ -150,7 +153,7 @@ enum status Block::write(Event &event)
 		else
 			data_page++;
 
-		Block_manager::instance()->update_block(this);
+		manager.update_block(this);
 	}
 	return ret;
 }
@@ -169,7 +172,6 @@ enum status Block::replace(Event &event)
 enum status Block::_erase(Event &event)
 {
 	assert(data != NULL && erase_delay >= 0.0);
-	uint i;
 
 	if (!event.get_noop())
 	{
@@ -179,11 +181,7 @@ enum status Block::_erase(Event &event)
 			return FAILURE;
 		}
 
-		for(i = 0; i < size; i++)
-		{
-			//assert(data[i].get_state() == INVALID);
-			data[i].set_state(EMPTY);
-		}
+		memset(data, 0, words * sizeof(ulong));
 
 		event.incr_time_taken(erase_delay);
 		last_erase_time = event.get_start_time() + event.get_time_taken();
@@ -194,7 +192,7 @@ enum status Block::_erase(Event &event)
 		data_page = 0; // Yoohyuk Lim
 		state = FREE;
 
-		Block_manager::instance()->update_block(this);
+		manager.update_block(this);
 	}
 
 	return SUCCESS;
@@ -224,13 +222,60 @@ enum block_state Block::get_state(void) const
 enum page_state Block::get_state(uint page) const
 {
 	assert(data != NULL && page < size);
-	return data[page].get_state();
+	return (enum page_state) ((data[page / PAGES_PER_WORD] >> (2 * (page % PAGES_PER_WORD))) & 3);
 }
 
 enum page_state Block::get_state(const Address &address) const
 {
    assert(data != NULL && address.page < size && address.valid >= BLOCK);
-   return data[address.page].get_state();
+   return get_state(address.page);
+}
+
+void Block::set_state(uint page, enum page_state state)
+{
+	assert(data != NULL && page < size);
+	uint shift = 2 * (page % PAGES_PER_WORD);
+	ulong &word = data[page / PAGES_PER_WORD];
+	word = (word & ~(3ul << shift)) | ((ulong) state << shift);
+	return;
+}
+
+/* low bits of the page states in the given word that belong to the block */
+ssd::ulong Block::page_mask(uint word) const
+{
+	uint pages = size - word * PAGES_PER_WORD;
+	if(pages >= PAGES_PER_WORD)
+		return LOW_BITS;
+	return LOW_BITS & ((1ul << (2 * pages)) - 1);
+}
+
+/* number of pages of the block in the given state */
+ssd::uint Block::count_pages(enum page_state state) const
+{
+	assert(data != NULL);
+	uint count = 0;
+	for(uint i = 0; i * PAGES_PER_WORD < size; i++)
+		count += __builtin_popcountl(match_state(data[i], state) & page_mask(i));
+	return count;
+}
+
+/* first page at or after the given page that is in the given state
+ * returns the block size if there is none */
+ssd::uint Block::find_page(enum page_state state, uint page) const
+{
+	assert(data != NULL);
+	for(uint i = page / PAGES_PER_WORD; i * PAGES_PER_WORD < size; i++)
+	{
+		ulong found = match_state(data[i], state) & page_mask(i);
+
+		/* skip the pages before the first one of the search */
+		if(i == page / PAGES_PER_WORD)
+			found &= ~0ul << (2 * (page % PAGES_PER_WORD));
+
+		if(found != 0)
+			return i * PAGES_PER_WORD + __builtin_ctzl(found) / 2;
+	}
+	return size;
 }
 
 double Block::get_last_erase_time(void) const
@@ -252,12 +297,12 @@ void Block::invalidate_page(uint page)
 {
 	assert(page < size);
 
-	if (data[page].get_state() == INVALID )
+	if (get_state(page) == INVALID )
 		return;
 
-	//assert(data[page].get_state() == VALID);
+	//assert(get_state(page) == VALID);
 
-	data[page].set_state(INVALID);
+	set_state(page, INVALID);
 
 	pages_invalid++;
 
@@ -269,7 +314,7 @@ void Block::invalidate_page(uint page)
 	else
 		state = FREE;
 	
-    Block_manager::instance()->update_block(this);
+    manager.update_block(this);
 
 	return;
 }
@@ -293,13 +338,11 @@ enum status Block::get_next_page(Address &address) const
     else
         reminder = physical_address % BLOCK_SIZE;
 
-	for(i = 0; i < size; i++)
+	i = find_page(EMPTY);
+	if(i < size)
 	{
-		if(data[i].get_state() == EMPTY)
-		{
-			address.set_linear_address(i + physical_address - reminder, PAGE);
-			return SUCCESS;
-		}
+		address.set_linear_address(i + physical_address - reminder, PAGE);
+		return SUCCESS;
 	}
 
     return FAILURE;
@@ -334,7 +377,6 @@ block_cell_type Block::get_cell_type(void) const
 // Yoohyuk Lim
 void Block::set_cell_type(block_cell_type ctype)
 {
-    uint read_delay, write_delay;
     if (ctype == MLC)
     {
         this->size  = MLC_BLOCK_SIZE;
@@ -349,9 +391,6 @@ void Block::set_cell_type(block_cell_type ctype)
     }
 
     this->ctype = ctype;
-
-    for (uint i=0; i<size; i++)
-        data[i].set_delayes(read_delay, write_delay);
 }
 
 // Yoohyuk Lim
@@ -359,3 +398,23 @@ void Block::print_status()
 {
 	printf("parity : %3u data : %3u\n", parity_page, data_page);
 }
+
+/* The delays of a restored block follow the configuration it is loaded with,
+ * so experiments started from one snapshot can vary the flash timings. */
+void Block::snapshot(Snapshot &snapshot)
+{
+	snapshot.array(data, words);
+	snapshot.value(pages_valid);
+	snapshot.value(pages_invalid);
+	snapshot.value(parity_page);
+	snapshot.value(data_page);
+	snapshot.value(state);
+	snapshot.value(erases_remaining);
+	snapshot.value(last_erase_time);
+	snapshot.value(modification_time);
+	snapshot.value(btype);
+	snapshot.value(ctype);
+	if (snapshot.is_loading() && SLC_MLC_ENABLE == true)
+		set_cell_type(ctype);
+	snapshot.value(size);
+}
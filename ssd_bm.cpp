@@ -6,6 +6,7 @@
  * algorithms.
  */
 
+#include <cmath>
 #include <new>
 #include <assert.h>
 #include <stdio.h>
@@ -51,12 +52,25 @@ Block_manager::Block_manager(FtlParent *ftl) : ftl(ftl)
     for (int i=0; i<CELL_TYPE_NUM; i++)
     	data_active[i] = 0;
 	log_active = 0;
+	map_active = 0;
 
 	current_writing_block = -2;
+	die_striping = false;
 
 	out_of_blocks = false;
-
-	active_cost.reserve(NUMBER_OF_TOTAL_BLOCKS);
+	collecting = false;
+
+	uint max_block_size = std::max(BLOCK_SIZE, block_size);
+	if (SLC_MLC_ENABLE == true)
+		max_block_size = std::max(max_block_size, SLC_BLOCK_SIZE);
+	cost_buckets.assign(max_block_size + 1, NULL);
+	max_cost_bucket = 0;
+
+	/* Yoohyuk Lim
+	 * Add the over provisioning blocks to free list.
+	 * Blocks are created when first used, so keep their addresses. */
+	for (ulong b = NUMBER_OF_ADDRESSABLE_BLOCKS; b < NUMBER_OF_TOTAL_BLOCKS; b++)
+		free_list.push_back(b * block_size);
 }
 
 Block_manager::~Block_manager(void)
@@ -66,17 +80,64 @@ Block_manager::~Block_manager(void)
 
 void Block_manager::cost_insert(Block *b)
 {
-	active_cost.push_back(b);
+	cost_link(b);
+}
+
+/* put the block first in the bucket of its number of invalid pages */
+void Block_manager::cost_link(Block *b)
+{
+	uint bucket = b->pages_invalid;
+	if (bucket >= cost_buckets.size())
+		cost_buckets.resize(bucket + 1, NULL);
+
+	b->cost_bucket = bucket;
+	b->cost_prev = NULL;
+	b->cost_next = cost_buckets[bucket];
+	if (b->cost_next != NULL)
+		b->cost_next->cost_prev = b;
+	cost_buckets[bucket] = b;
+
+	if (bucket > max_cost_bucket)
+		max_cost_bucket = bucket;
+}
+
+void Block_manager::cost_unlink(Block *b)
+{
+	if (b->cost_prev != NULL)
+		b->cost_prev->cost_next = b->cost_next;
+	else
+		cost_buckets[b->cost_bucket] = b->cost_next;
+	if (b->cost_next != NULL)
+		b->cost_next->cost_prev = b->cost_prev;
+}
+
+/* block with the most invalid pages, NULL if there are no blocks */
+Block *Block_manager::first_victim()
+{
+	while (max_cost_bucket > 0 && cost_buckets[max_cost_bucket] == NULL)
+		max_cost_bucket--;
+	return cost_buckets[max_cost_bucket];
 }
 
-void Block_manager::instance_initialize(FtlParent *ftl)
+/* first block from b on that is completely written, or has no invalid pages.
+ * Open blocks, such as the DFTL translation block, can collect the most
+ * invalid pages but cannot be erased yet. */
+Block *Block_manager::skip_open_blocks(Block *b) const
 {
-	Block_manager::inst = new Block_manager(ftl);
+	while (b != NULL && b->get_pages_invalid() > 0 && b->get_pages_valid() != b->get_size())
+		b = next_victim(b);
+	return b;
 }
 
-Block_manager *Block_manager::instance()
+/* next block in order of decreasing invalid pages, NULL after the last */
+Block *Block_manager::next_victim(const Block *b) const
 {
-	return Block_manager::inst;
+	if (b->cost_next != NULL)
+		return b->cost_next;
+	for (uint i = b->cost_bucket; i-- > 0;)
+		if (cost_buckets[i] != NULL)
+			return cost_buckets[i];
+	return NULL;
 }
 
 /*
@@ -100,8 +161,9 @@ void Block_manager::get_page_block(Address &address, Event &event)
 
 	if (simpleCurrentFree < max_blocks * block_size)
 	{
-		address.set_linear_address(simpleCurrentFree, BLOCK);
-		current_writing_block = simpleCurrentFree;
+		ulong block = interleave_blocks(simpleCurrentFree / block_size) * block_size;
+		address.set_linear_address(block, BLOCK);
+		current_writing_block = block;
     	simpleCurrentFree += block_size;
 	}
 	else
@@ -113,9 +175,10 @@ void Block_manager::get_page_block(Address &address, Event &event)
 		}
 
 		assert(free_list.size() != 0);
-		address.set_linear_address(free_list.front()->get_physical_address(), BLOCK);
-		current_writing_block = free_list.front()->get_physical_address();
-		free_list.erase(free_list.begin());
+		std::vector<long>::iterator next = next_free_block();
+		address.set_linear_address(*next, BLOCK);
+		current_writing_block = *next;
+		free_list.erase(next);
 		out_of_blocks = false;
 	}
    
@@ -143,6 +206,80 @@ void Block_manager::get_page_block(Address &address, Event &event)
 	ftl->controller.stats.numCellAlloc[ctype]++;
 }
 
+/*
+ * With multi-plane operations fresh blocks are handed out round robin over
+ * the planes of a die, so blocks allocated one after another are siblings
+ * at the same offset.  With die striping they go round robin over the dies
+ * first.  Dies left incomplete by the addressable space keep the linear
+ * order.
+ */
+ulong Block_manager::interleave_blocks(ulong block) const
+{
+	ulong group = (ulong) DIE_SIZE * PLANE_SIZE;
+	ulong dies = max_blocks / group;
+
+	if (block >= dies * group)
+		return block;
+
+	ulong die = block / group;
+	ulong offset = block % group;
+
+	if (die_striping)
+	{
+		die = block % dies;
+		offset = block / dies;
+	}
+
+	if (MULTI_PLANE_ENABLE)
+		offset = (offset % DIE_SIZE) * PLANE_SIZE + offset / DIE_SIZE;
+
+	return die * group + offset;
+}
+
+/*
+ * Picks the free block to reuse.  With die striping a block on the die after
+ * the last allocated block is preferred, so the open blocks of the FTL stay
+ * spread over the dies.  Otherwise, with multi-plane operations, a block on
+ * the plane after the last allocated block, in the same die, is preferred so
+ * the open blocks of the FTL stay on sibling planes.
+ */
+std::vector<long>::iterator Block_manager::next_free_block(void)
+{
+	ulong group = (ulong) DIE_SIZE * PLANE_SIZE;
+	ulong last = current_writing_block / block_size;
+
+	if (die_striping)
+	{
+		ulong dies = (ulong) SSD_SIZE * PACKAGE_SIZE;
+		ulong die = (last / group + 1) % dies;
+
+		for (std::vector<long>::iterator it = free_list.begin(); it != free_list.end(); ++it)
+			if ((ulong) *it / block_size / group == die)
+				return it;
+		return free_list.begin();
+	}
+
+	if (!MULTI_PLANE_ENABLE || DIE_SIZE < 2)
+		return free_list.begin();
+
+	ulong plane = (last % group) / PLANE_SIZE;
+	ulong first = last - last % group + ((plane + 1) % DIE_SIZE) * PLANE_SIZE;
+
+	for (std::vector<long>::iterator it = free_list.begin(); it != free_list.end(); ++it)
+	{
+		ulong block = *it / block_size;
+		if (block >= first && block < first + PLANE_SIZE)
+			return it;
+	}
+	return free_list.begin();
+}
+
+/* Hand out blocks round robin over all dies, for FTLs that keep an open
+ * block on every die. */
+void Block_manager::stripe_dies(void)
+{
+	die_striping = true;
+}
 
 Address Block_manager::get_free_block(Event &event)
 {
@@ -185,6 +322,7 @@ void Block_manager::print_statistics(FILE *stream)
 	fprintf(stream, "Block Statistics:\n");
 	fprintf(stream, "-----------------\n");
 	fprintf(stream, "Log blocks:  %lu\n", log_active);
+	fprintf(stream, "Map blocks:  %lu\n", map_active);
     if (SLC_MLC_ENABLE == true)
     {
        	fprintf(stream, "Data blocks: SLC: %lu MLC: %lu\n", data_active[SLC], data_active[MLC]);
@@ -230,6 +368,9 @@ void Block_manager::invalidate(Address address, block_type type)
 		break;
 	case LOG_SEQ:
 		break;
+	case MAP:
+		map_active--;
+		break;
 	}
 }
 
@@ -239,6 +380,11 @@ void Block_manager::invalidate(Address address, block_type type)
  */
 void Block_manager::insert_events(Event &event)
 {
+	// Cleaning a victim may allocate blocks (DFTL moves translation
+	// pages), which must not start a collection inside this one.
+	if (collecting)
+		return;
+
 	// Calculate if GC should be activated.
 	float used;
 	float total = NUMBER_OF_TOTAL_BLOCKS;// - op_size;
@@ -247,9 +393,9 @@ void Block_manager::insert_events(Event &event)
     if (SLC_MLC_ENABLE == true)
         // invalid_list and log_active are not used in DFTL,
         // thus we don't care about it.
-        used = (int)data_active[MLC] + (int)data_active[SLC];
+        used = (int)data_active[MLC] + (int)data_active[SLC] + (int)map_active;
     else
-	    used = (int)invalid_list.size() + (int)log_active + (int)data_active[MLC];
+	    used = (int)invalid_list.size() + (int)log_active + (int)data_active[MLC] + (int)map_active;
 
     ratio = (float) used / total;
 
@@ -258,7 +404,11 @@ void Block_manager::insert_events(Event &event)
 
 	uint num_to_erase = 5; // More Magic!
 
+	collecting = true;
 	double time_taken = event.get_time_taken();
+	bool tracing = FlashTrace::is_enabled();
+	if (tracing)
+		FlashTrace::begin_gc();
 
 //	printf("%f %4lu %4lu %4lu\n", ratio, (ulong) free_list.size(), data_active[MLC], data_active[SLC]);
 
@@ -267,14 +417,14 @@ void Block_manager::insert_events(Event &event)
 	// First step and least expensive is to go though invalid list. (Only used by FAST)
 	while (num_to_erase != 0 && invalid_list.size() != 0)
 	{
-		Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
+		Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 		erase_event.set_address(Address(invalid_list.back()->get_physical_address(), BLOCK));
 		block_cell_type ctype = ftl->controller.get_block_pointer(erase_event.get_address())->get_cell_type();
 
 		if (ftl->controller.issue(erase_event) == FAILURE) {	assert(false);}
 		event.incr_time_taken(erase_event.get_time_taken());
 
-		free_list.push_back(invalid_list.back());
+		free_list.push_back(invalid_list.back()->get_physical_address());
 		invalid_list.pop_back();
 
 		num_to_erase--;
@@ -285,52 +435,63 @@ void Block_manager::insert_events(Event &event)
 
 	num_insert_events++;
 
-	if (FTL_IMPLEMENTATION == IMPL_DFTL || FTL_IMPLEMENTATION == IMPL_BIMODAL)
+	if (FTL_IMPLEMENTATION == IMPL_PAGE || FTL_IMPLEMENTATION == IMPL_DFTL || FTL_IMPLEMENTATION == IMPL_BIMODAL)
 	{
+		/* only the victim walks are GC selection, the copies and erases
+		 * count as the FTL and flash work they are */
+		Block *it;
+		{
+			PROFILE_SCOPE(PROFILE_GC);
+			it = skip_open_blocks(first_victim());
+		}
 
-		ActiveByCost::iterator it = active_cost.get<1>().end();
-		--it;
-
-		while (num_to_erase != 0 && (*it)->get_pages_invalid() > 0 && (*it)->get_pages_valid() == (*it)->get_size())
+		while (num_to_erase != 0 && it != NULL && it->get_pages_invalid() > 0 && it->get_pages_valid() == it->get_size())
 		{
 			// Erase SLC blocks for first.
-			if (SLC_MLC_ENABLE == true && (*it)->get_cell_type() != SLC)
+			if (SLC_MLC_ENABLE == true && it->get_cell_type() != SLC)
 			{
-				ActiveByCost::iterator _it = it;
+				PROFILE_SCOPE(PROFILE_GC);
+				Block *_it = it;
 				
-				while(_it != active_cost.get<1>().begin() && (*_it)->get_cell_type() != SLC) --_it;
+				while(next_victim(_it) != NULL && _it->get_cell_type() != SLC) _it = next_victim(_it);
 
 				// Only if the overhead of erasing the MLC block (it) is higher than the SLC block (_it)
-				if (_it != active_cost.get<1>().begin()
-						&& (*_it)->get_pages_invalid() > 0
-						&& (*_it)->get_pages_valid() == (*_it)->get_size()
-						&& ((*_it)->get_size() - (*_it)->get_pages_invalid()) <= ((*it)->get_size() - (*it)->get_pages_invalid()))
+				if (next_victim(_it) != NULL
+						&& _it->get_pages_invalid() > 0
+						&& _it->get_pages_valid() == _it->get_size()
+						&& (_it->get_size() - _it->get_pages_invalid()) <= (it->get_size() - it->get_pages_invalid()))
 //						&& ((*_it)->get_size() - (*_it)->get_pages_invalid()) * (SLC_WRITE_DELAY + SLC_READ_DELAY)
 //							<= ((*it)->get_size() - (*it)->get_pages_invalid()) * (MLC_WRITE_DELAY + MLC_READ_DELAY))
 					it = _it;
 			}
 
-			if (current_writing_block != (*it)->physical_address)
+			if (current_writing_block != it->physical_address)
 			{
-				//printf("erase p: %p phy: %li ratio: %i num: %i\n", (*it), (*it)->physical_address, (*it)->get_pages_invalid(), num_to_erase);
-				Block *blockErase = (*it);
+				//printf("erase p: %p phy: %li ratio: %i num: %i\n", it, it->physical_address, it->get_pages_invalid(), num_to_erase);
+				Block *blockErase = it;
 				block_cell_type ctype = blockErase->get_cell_type();
 
 				// Let the FTL handle cleanup of the block.
 				ftl->cleanup_block(event, blockErase);
 
 				// Create erase event and attach to current event queue.
-				Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time(), event.get_streamID());
+				Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken(), event.get_streamID());
 				erase_event.set_address(Address(blockErase->get_physical_address(), BLOCK));
 
 				// Execute erase
 				if (ftl->controller.issue(erase_event) == FAILURE) { assert(false);	}
 
-				free_list.push_back(blockErase);
-				data_active[ctype]--;
-				
-				if (ctype == SLC && data_active[ctype] >= NUMBER_OF_OVERPROVISIONING_BLOCKS)
-					++op_size;
+				free_list.push_back(blockErase->get_physical_address());
+
+				if (blockErase->get_block_type() == MAP)
+					map_active--;
+				else
+				{
+					data_active[ctype]--;
+
+					if (ctype == SLC && data_active[ctype] >= NUMBER_OF_OVERPROVISIONING_BLOCKS)
+						++op_size;
+				}
 
 				event.incr_time_taken(erase_event.get_time_taken());
 
@@ -339,17 +500,27 @@ void Block_manager::insert_events(Event &event)
 				ftl->controller.stats.numCellErase[ctype]++;
 			}
 
-			it = active_cost.get<1>().end();
-			--it;
-            
-			if (current_writing_block == (*it)->physical_address)
-                --it;
+			{
+				PROFILE_SCOPE(PROFILE_GC);
+				it = skip_open_blocks(first_victim());
+
+				if (it != NULL && current_writing_block == it->physical_address)
+					it = skip_open_blocks(next_victim(it));
+			}
 
 			num_to_erase--;
 		}
 	}
 
+	collecting = false;
 	ftl->controller.stats.GCElapsedTime += event.get_time_taken() - time_taken;
+
+	if (tracing)
+	{
+		FlashTrace::end_gc();
+		if (event.get_time_taken() > time_taken)
+			FlashTrace::record_gc(event.get_start_time() + time_taken, event.get_time_taken() - time_taken, event.get_streamID());
+	}
 }
 
 // Yoohyuk Lim
@@ -374,6 +545,11 @@ Address Block_manager::get_free_block(block_type type, Event &event)
 		block->set_block_type(LOG);
 		log_active++;
 		break;
+	case MAP:
+		// Translation pages of DFTL
+		block->set_block_type(MAP);
+		map_active++;
+		break;
 	default:
 		break;
 	}
@@ -399,14 +575,11 @@ void Block_manager::print_cost_status(FILE *stream)
 	if (stream == NULL)
 		stream = stdout;
 
-	ActiveByCost::iterator it = active_cost.get<1>().end();
-	--it;
-
 //	fprintf(stream,"Address\tvalid\tinvalid\n");
-	for (;it != active_cost.get<1>().begin();--it) //SSD_SIZE*PACKAGE_SIZE*DIE_SIZE*PLANE_SIZE
+	for (Block *it = first_victim(); it != NULL; it = next_victim(it)) //SSD_SIZE*PACKAGE_SIZE*DIE_SIZE*PLANE_SIZE
 	{
-		fprintf(stream,"%s\t%li\t%i\t%i\n", (*it)->get_cell_type() == SLC ? "SLC" : "MLC",
-				(*it)->physical_address, (*it)->get_pages_valid(), (*it)->get_pages_invalid());
+		fprintf(stream,"%s\t%li\t%i\t%i\n", it->get_cell_type() == SLC ? "SLC" : "MLC",
+				it->physical_address, it->get_pages_valid(), it->get_pages_invalid());
 	}
 }
 
@@ -421,7 +594,7 @@ void Block_manager::erase_and_invalidate(Event &event, Address &address, block_t
 
 	if (ftl->controller.issue(erase_event) == FAILURE) { assert(false);}
 
-	free_list.push_back(block);
+	free_list.push_back(block->get_physical_address());
 
 	switch (btype)
 	{
@@ -433,6 +606,9 @@ void Block_manager::erase_and_invalidate(Event &event, Address &address, block_t
 		break;
 	case LOG_SEQ:
 		break;
+	case MAP:
+		map_active--;
+		break;
 	}
 
 	event.incr_time_taken(erase_event.get_time_taken());
@@ -454,12 +630,75 @@ int Block_manager::get_num_free_blocks()
 /* Yoohyuk Lim */
 void Block_manager::update_block(Block * b)
 {
-    std::size_t pos = b->physical_address / block_size;
-	active_cost.replace(active_cost.begin()+pos, b);
+	if (b->pages_invalid == b->cost_bucket)
+		return;
+	cost_unlink(b);
+	cost_link(b);
 }
 
-/* Yoohyuk Lim */
-void Block_manager::add_to_free_list(Block *b)
+/* Blocks are saved as their addresses.  The victim buckets keep their order,
+ * so restored runs pick the same victims. */
+void Block_manager::snapshot(Snapshot &snapshot)
 {
-	free_list.push_back(b);
+	snapshot.array(data_active, CELL_TYPE_NUM);
+	snapshot.value(log_active);
+	snapshot.value(logseq_active);
+	snapshot.value(map_active);
+	snapshot.value(die_striping);
+	snapshot.value(max_log_blocks);
+	snapshot.value(max_blocks);
+	snapshot.value(max_map_pages);
+	snapshot.value(map_space_capacity);
+	snapshot.value(block_size);
+
+	ulong buckets = cost_buckets.size();
+	snapshot.value(buckets);
+	if (snapshot.is_loading())
+		cost_buckets.assign(buckets, NULL);
+	for (uint i = 0; i < buckets; i++)
+	{
+		ulong count = 0;
+		for (Block *b = cost_buckets[i]; b != NULL; b = b->cost_next)
+			count++;
+		snapshot.value(count);
+
+		Block *prev = NULL;
+		for (Block *b = cost_buckets[i]; count-- > 0; b = b->cost_next)
+		{
+			ftl->snapshot_block(snapshot, b);
+			if (snapshot.is_loading())
+			{
+				b->cost_bucket = i;
+				b->cost_prev = prev;
+				b->cost_next = NULL;
+				if (prev != NULL)
+					prev->cost_next = b;
+				else
+					cost_buckets[i] = b;
+				prev = b;
+			}
+		}
+	}
+	snapshot.value(max_cost_bucket);
+
+	std::vector<Block*> *lists[2] = {&active_list, &invalid_list};
+	for (uint l = 0; l < 2; l++)
+	{
+		ulong count = lists[l]->size();
+		snapshot.value(count);
+		if (snapshot.is_loading())
+			lists[l]->assign(count, NULL);
+		for (ulong i = 0; i < count; i++)
+			ftl->snapshot_block(snapshot, (*lists[l])[i]);
+	}
+	snapshot.vector(free_list);
+
+	snapshot.value(directoryCurrentPage);
+	snapshot.value(directoryCachedPage);
+	snapshot.value(simpleCurrentFree);
+	snapshot.value(num_insert_events);
+	snapshot.value(current_writing_block);
+	snapshot.value(op_size);
+	snapshot.value(inited);
+	snapshot.value(out_of_blocks);
 }
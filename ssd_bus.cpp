@@ -115,10 +115,10 @@ enum status Bus::disconnect(uint channel)
  * assumes event is sent across channel as soon as bus is available
  * event may fail if channel is saturated so check return value
  */
-enum status Bus::lock(uint channel, double start_time, double duration, Event &event)
+enum status Bus::lock(uint channel, double now, double start_time, double duration, Event &event)
 {
 	assert(channels != NULL && start_time >= 0.0 && duration > 0.0);
-	return channels[channel].lock(start_time, duration, event);
+	return channels[channel].lock(now, start_time, duration, event);
 }
 
 Channel &Bus::get_channel(uint channel)
@@ -132,3 +132,10 @@ double Bus::ready_time(uint channel)
 	assert(channels != NULL && channel < num_channels);
 	return channels[channel].ready_time();
 }
+
+void Bus::snapshot(Snapshot &snapshot)
+{
+	assert(channels != NULL);
+	for (uint i = 0; i < num_channels; i++)
+		channels[i].snapshot(snapshot);
+}
@@ -68,9 +68,7 @@ Channel::Channel(double ctrl_delay, double data_delay, uint table_size, uint max
 		data_delay = 0.0;
 	}
 
-	timings.reserve(4096);
-
-	ready_at = -1;
+	return;
 }
 
 /* free allocated bus channel state space */
@@ -120,67 +118,21 @@ enum status Channel::disconnect(void)
  * event is sent across bus as soon as bus channel is available
  * event may fail if bus channel is saturated so check return value
  */
-enum status Channel::lock(double start_time, double duration, Event &event)
+enum status Channel::lock(double now, double start_time, double duration, Event &event)
 {
+	PROFILE_SCOPE(PROFILE_CHANNEL);
 	assert(num_connected <= max_connections);
 	assert(ctrl_delay >= 0.0);
 	assert(data_delay >= 0.0);
 	assert(start_time >= 0.0);
 	assert(duration >= 0.0);
 
-	/* free up any table slots and sort existing ones */
-	unlock(start_time);
-
-	double sched_time = BUS_CHANNEL_FREE_FLAG;
-
-	/* just schedule if table is empty */
-	if(timings.size() == 0)
-		sched_time = start_time;
-
-	/* check if can schedule before or in between before just scheduling
-	 * after all other events */
-	else
-	{
-		/* skip over empty table entries
-		 * empty table entries will be first from sorting (in unlock method)
-		 * because the flag is a negative value */
-		std::vector<lock_times>::iterator it = timings.begin();
-
-		/* schedule before first event in table */
-		if((*it).lock_time > start_time && (*it).lock_time - start_time >= duration)
-			sched_time = start_time;
-
-		/* schedule in between other events in table */
-		if(sched_time == BUS_CHANNEL_FREE_FLAG)
-		{
-			for(; it < timings.end(); it++)
-			{
-				if (it + 1 != timings.end())
-				{
-					/* enough time to schedule in between next two events */
-					if((*it).unlock_time >= start_time  && (*(it+1)).lock_time - (*it).unlock_time >= duration)
-					{
-						sched_time = (*it).unlock_time;
-						break;
-					}
-				}
-
-			}
-		}
-
-		/* schedule after all events in table */
-		if(sched_time == BUS_CHANNEL_FREE_FLAG)
-			sched_time = timings.back().unlock_time;
-	}
+	/* the timeline expires transfers finished by now and finds the earliest
+	 * slot before, in between or after the transfers already scheduled */
+	double sched_time = timings.lock(now, start_time, duration);
 
-	/* write scheduling info in free table slot */
-	lock_times lt;
-	lt.lock_time = sched_time;
-	lt.unlock_time = sched_time + duration;
-	timings.push_back(lt);
-
-	if (lt.unlock_time > ready_at)
-		ready_at = lt.unlock_time;
+	if(FlashTrace::is_enabled())
+		FlashTrace::record(FlashTrace::BUS_TRANSFER, sched_time, duration, event);
 
 	/* update event times for bus wait and time taken */
 	event.incr_bus_wait_time(sched_time - start_time);
@@ -189,31 +141,13 @@ enum status Channel::lock(double start_time, double duration, Event &event)
 	return SUCCESS;
 }
 
-/* remove all expired entries (finish time is less than provided time)
- * update current number of table entries used
- * sort table by finish times (2nd row) */
-void Channel::unlock(double start_time)
+double Channel::ready_time(void)
 {
-	/* remove expired channel lock entries */
-	std::vector<lock_times>::iterator it;
-	for ( it = timings.begin(); it < timings.end();)
-	{
-		if((*it).unlock_time <= start_time)
-			timings.erase(it);
-		else
-		{
-			it++;
-		}
-	}
-	std::sort(timings.begin(), timings.end(), &timings_sorter);
+	return timings.ready_time();
 }
 
-bool Channel::timings_sorter(lock_times const& lhs, lock_times const& rhs) {
-    return lhs.lock_time < rhs.lock_time;
-}
-
-double Channel::ready_time(void)
+void Channel::snapshot(Snapshot &snapshot)
 {
-	return ready_at;
+	timings.snapshot(snapshot);
 }
 
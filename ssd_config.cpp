@@ -66,6 +66,16 @@ typedef unsigned long ulong;
 double RAM_READ_DELAY = 0.00000001;
 double RAM_WRITE_DELAY = 0.00000001;
 
+/* Ram class write buffer:
+ * 	number of pages the controller buffers in RAM (0 disables the buffer)
+ * 	eviction policy (0 -> LRU, 1 -> CFLRU, 2 -> BPLRU)
+ * 	number of least recently used pages CFLRU searches for a clean victim
+ * 	idle time after which buffered dirty pages are flushed (0 disables) */
+uint RAM_BUFFER_SIZE = 0;
+uint RAM_BUFFER_POLICY = 0;
+uint RAM_BUFFER_CLEAN_WINDOW = 64;
+double RAM_BUFFER_IDLE_FLUSH = 0.0;
+
 /* Bus class:
  * 	delay to communicate over bus
  * 	max number of connected devices allowed
@@ -89,8 +99,12 @@ uint SSD_SIZE = 4;
 uint PACKAGE_SIZE = 8;
 
 /* Die class:
- * 	number of Planes per Die (size) */
+ * 	number of Planes per Die (size)
+ * 	issue operations on sibling planes as one multi-plane operation
+ * 	pipeline programs and reads through the plane cache register */
 uint DIE_SIZE = 2;
+bool MULTI_PLANE_ENABLE = false;
+bool CACHE_MODE_ENABLE = false;
 
 /* Plane class:
  * 	number of Blocks per Plane (size)
@@ -149,11 +163,6 @@ double OVERPROVISIONING_RATIO = 0.0;
 
 //Yoohyuk - end
 
-/*
- * Memory area to support pages with data.
- */
-void *page_data;
-
 /*
  * Number of blocks to reserve for mappings. e.g. map directory in BAST.
  */
@@ -182,6 +191,13 @@ uint FAST_LOG_PAGE_LIMIT = 4;
  */
 uint CACHE_DFTL_LIMIT = 8;
 
+/*
+ * Number of least recently used DFTL CMT entries considered together on
+ * eviction. Clean entries among them are evicted first, otherwise the
+ * translation page holding most of their dirty entries is written back.
+ */
+uint CACHE_DFTL_EVICT_WINDOW = 32;
+
 /*
  * Parallelism mode.
  * 0 -> Normal
@@ -205,15 +221,33 @@ uint NUMBER_OF_OVERPROVISIONING_BLOCKS = 0; //Yoohyuk Lim
 uint RAID_NUMBER_OF_PHYSICAL_SSDS = 0;
 
 /* Yoohyuk Lim
- * RAID level */
+ * RAID level (0, 5 or 6) */
 uint RAID_LEVEL = 0;
 
+/* RAID chunk size: number of consecutive pages on one SSD of the array */
+uint RAID_CHUNK_SIZE = 1;
+
+/* Number of threads simulating the SSDs of the array, including the caller.
+ * 0 uses one thread per hardware thread. */
+uint RAID_THREADS = 0;
+
+/* Length of the intervals of the interval statistics log */
+double STATS_INTERVAL = 1000.0;
+
 void load_entry(char *name, double value, uint line_number) {
 	/* cheap implementation - go through all possibilities and match entry */
 	if (!strcmp(name, "RAM_READ_DELAY"))
 		RAM_READ_DELAY = value;
 	else if (!strcmp(name, "RAM_WRITE_DELAY"))
 		RAM_WRITE_DELAY = value;
+	else if (!strcmp(name, "RAM_BUFFER_SIZE"))
+		RAM_BUFFER_SIZE = value;
+	else if (!strcmp(name, "RAM_BUFFER_POLICY"))
+		RAM_BUFFER_POLICY = value;
+	else if (!strcmp(name, "RAM_BUFFER_CLEAN_WINDOW"))
+		RAM_BUFFER_CLEAN_WINDOW = value;
+	else if (!strcmp(name, "RAM_BUFFER_IDLE_FLUSH"))
+		RAM_BUFFER_IDLE_FLUSH = value;
 	else if (!strcmp(name, "BUS_CTRL_DELAY"))
 		BUS_CTRL_DELAY = value;
 	else if (!strcmp(name, "BUS_DATA_DELAY"))
@@ -228,6 +262,10 @@ void load_entry(char *name, double value, uint line_number) {
 		PACKAGE_SIZE = (uint) value;
 	else if (!strcmp(name, "DIE_SIZE"))
 		DIE_SIZE = (uint) value;
+	else if (!strcmp(name, "MULTI_PLANE_ENABLE"))
+		MULTI_PLANE_ENABLE = value;
+	else if (!strcmp(name, "CACHE_MODE_ENABLE"))
+		CACHE_MODE_ENABLE = value;
 	else if (!strcmp(name, "PLANE_SIZE"))
 		PLANE_SIZE = (uint) value;
 	else if (!strcmp(name, "PLANE_REG_READ_DELAY"))
@@ -284,6 +322,16 @@ void load_entry(char *name, double value, uint line_number) {
 		FAST_LOG_PAGE_LIMIT = value;
 	else if (!strcmp(name, "CACHE_DFTL_LIMIT"))
 		CACHE_DFTL_LIMIT = value;
+	else if (!strcmp(name, "CACHE_DFTL_EVICT_WINDOW"))
+	{
+		/* eviction has to consider at least the least recently used entry */
+		if (value < 1)
+		{
+			fprintf(stderr, "Config file error on line %u: CACHE_DFTL_EVICT_WINDOW must be at least 1\n", line_number);
+			exit(FILE_ERR);
+		}
+		CACHE_DFTL_EVICT_WINDOW = value;
+	}
 	else if (!strcmp(name, "PARALLELISM_MODE"))
 		PARALLELISM_MODE = value;
 	else if (!strcmp(name, "VIRTUAL_BLOCK_SIZE"))
@@ -295,6 +343,12 @@ void load_entry(char *name, double value, uint line_number) {
     //Yoohyuk Lim
     else if (!strcmp(name, "RAID_LEVEL"))
         RAID_LEVEL = value;
+	else if (!strcmp(name, "RAID_CHUNK_SIZE"))
+		RAID_CHUNK_SIZE = value;
+	else if (!strcmp(name, "RAID_THREADS"))
+		RAID_THREADS = value;
+	else if (!strcmp(name, "STATS_INTERVAL"))
+		STATS_INTERVAL = value;
 	else
 		fprintf(stderr, "Config file parsing error on line %u\n", line_number);
 	return;
@@ -363,6 +417,10 @@ void print_config(FILE *stream) {
 		stream = stdout;
 	fprintf(stream, "RAM_READ_DELAY: %.16lf\n", RAM_READ_DELAY);
 	fprintf(stream, "RAM_WRITE_DELAY: %.16lf\n", RAM_WRITE_DELAY);
+	fprintf(stream, "RAM_BUFFER_SIZE: %u\n", RAM_BUFFER_SIZE);
+	fprintf(stream, "RAM_BUFFER_POLICY: %u\n", RAM_BUFFER_POLICY);
+	fprintf(stream, "RAM_BUFFER_CLEAN_WINDOW: %u\n", RAM_BUFFER_CLEAN_WINDOW);
+	fprintf(stream, "RAM_BUFFER_IDLE_FLUSH: %.16lf\n", RAM_BUFFER_IDLE_FLUSH);
 	fprintf(stream, "BUS_CTRL_DELAY: %.16lf\n", BUS_CTRL_DELAY);
 	fprintf(stream, "BUS_DATA_DELAY: %.16lf\n", BUS_DATA_DELAY);
 	fprintf(stream, "BUS_MAX_CONNECT: %u\n", BUS_MAX_CONNECT);
@@ -370,6 +428,8 @@ void print_config(FILE *stream) {
 	fprintf(stream, "SSD_SIZE: %u\n", SSD_SIZE);
 	fprintf(stream, "PACKAGE_SIZE: %u\n", PACKAGE_SIZE);
 	fprintf(stream, "DIE_SIZE: %u\n", DIE_SIZE);
+	fprintf(stream, "MULTI_PLANE_ENABLE: %i\n", MULTI_PLANE_ENABLE);
+	fprintf(stream, "CACHE_MODE_ENABLE: %i\n", CACHE_MODE_ENABLE);
 	fprintf(stream, "PLANE_SIZE: %u\n", PLANE_SIZE);
 	fprintf(stream, "PLANE_REG_READ_DELAY: %.16lf\n", PLANE_REG_READ_DELAY);
 	fprintf(stream, "PLANE_REG_WRITE_DELAY: %.16lf\n", PLANE_REG_WRITE_DELAY);
@@ -401,8 +461,14 @@ void print_config(FILE *stream) {
     
     fprintf(stream, "MAP_DIRECTORY_SIZE: %i\n", MAP_DIRECTORY_SIZE);
 	fprintf(stream, "FTL_IMPLEMENTATION: %i\n", FTL_IMPLEMENTATION);
+	fprintf(stream, "CACHE_DFTL_LIMIT: %u\n", CACHE_DFTL_LIMIT);
+	fprintf(stream, "CACHE_DFTL_EVICT_WINDOW: %u\n", CACHE_DFTL_EVICT_WINDOW);
 	fprintf(stream, "PARALLELISM_MODE: %i\n", PARALLELISM_MODE);
 	fprintf(stream, "RAID_NUMBER_OF_PHYSICAL_SSDS: %i\n", RAID_NUMBER_OF_PHYSICAL_SSDS);
+	fprintf(stream, "RAID_LEVEL: %u\n", RAID_LEVEL);
+	fprintf(stream, "RAID_CHUNK_SIZE: %u\n", RAID_CHUNK_SIZE);
+	fprintf(stream, "RAID_THREADS: %u\n", RAID_THREADS);
+	fprintf(stream, "STATS_INTERVAL: %.16lf\n", STATS_INTERVAL);
 
 	return;
 }
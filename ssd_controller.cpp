@@ -29,9 +29,18 @@
  *
  * The controller also provides an interface for the FTL to collect wear
  * information to perform wear-leveling.
+ *
+ * With RAM_BUFFER_SIZE set, host writes are absorbed by the write buffer in
+ * RAM and overwrites of buffered pages coalesce there.  Reads of buffered
+ * pages are served from RAM and read misses are kept as clean pages.  Dirty
+ * pages reach the FTL when they are evicted, on a flush request and after
+ * the drive has been idle for RAM_BUFFER_IDLE_FLUSH, always as single page
+ * writes through the FTL and issue.
  */
 
 #include <new>
+#include <limits>
+#include <string.h>
 #include <assert.h>
 #include <stdio.h>
 #include "ssd.h"
@@ -39,7 +48,9 @@
 using namespace ssd;
 
 Controller::Controller(Ssd &parent):
-	ssd(parent)
+	ssd(parent),
+	last_finish(0.0),
+	unit_pages()
 {
 	switch (FTL_IMPLEMENTATION)
 	{
@@ -70,19 +81,182 @@ Controller::~Controller(void)
 
 enum status Controller::event_arrive(Event &event)
 {
+	PROFILE_SCOPE(PROFILE_FTL);
+
+	if(ssd.ram.get_buffer_size() > 0)
+		return buffer_event(event);
+
 	if(event.get_event_type() == READ)
 		return ftl->read(event);
 	else if(event.get_event_type() == WRITE)
 		return ftl->write(event);
 	else if(event.get_event_type() == TRIM)
 		return ftl->trim(event);
+	else if(event.get_event_type() == FLUSH)
+		return SUCCESS;
 	else
 		fprintf(stderr, "Controller: %s: Invalid event type\n", __func__);
 	return FAILURE;
 }
 
+/* Services a host request through the write buffer.  If the drive has been
+ * idle for RAM_BUFFER_IDLE_FLUSH since the last request finished, dirty pages
+ * are flushed in the idle period first, until the request arrives. */
+enum status Controller::buffer_event(Event &event)
+{
+	enum status ret = SUCCESS;
+
+	if (RAM_BUFFER_IDLE_FLUSH > 0.0 && ssd.ram.get_buffer_dirty() > 0 && event.get_start_time() >= last_finish + RAM_BUFFER_IDLE_FLUSH)
+	{
+		Event flushEvent = Event(FLUSH, 0, 1, last_finish + RAM_BUFFER_IDLE_FLUSH, STREAMID_DEFAULT);
+		ret = flush(flushEvent, event.get_start_time());
+	}
+
+	if (ret == SUCCESS)
+	{
+		if(event.get_event_type() == READ)
+			ret = buffer_read(event);
+		else if(event.get_event_type() == WRITE)
+			ret = buffer_write(event);
+		else if(event.get_event_type() == TRIM)
+			ret = buffer_trim(event);
+		else if(event.get_event_type() == FLUSH)
+			ret = flush(event, std::numeric_limits<double>::infinity());
+		else
+		{
+			fprintf(stderr, "Controller: %s: Invalid event type\n", __func__);
+			ret = FAILURE;
+		}
+	}
+
+	if (event.get_start_time() + event.get_time_taken() > last_finish)
+		last_finish = event.get_start_time() + event.get_time_taken();
+	return ret;
+}
+
+enum status Controller::buffer_read(Event &event)
+{
+	uint32_t page = ssd.ram.find_page(event.get_logical_address());
+
+	if (page != Ram::BUFFER_NIL)
+	{
+		ssd.ram.touch_page(page);
+		if (PAGE_ENABLE_DATA)
+			ssd.result_buffer = ssd.ram.get_data(page);
+		stats.numBufferReadHits++;
+		return ssd.ram.read(event);
+	}
+
+	/* make room before reading, as garbage collection triggered by the
+	 * write backs moves the result buffer */
+	if (make_room(event) == FAILURE)
+		return FAILURE;
+
+	if (PAGE_ENABLE_DATA)
+		ssd.result_buffer = NULL;
+	if (ftl->read(event) == FAILURE)
+		return FAILURE;
+
+	/* pages that were never written have no data to keep */
+	if (PAGE_ENABLE_DATA && ssd.result_buffer == NULL)
+		return SUCCESS;
+
+	page = ssd.ram.insert_page(event.get_logical_address(), event.get_streamID(), false);
+	if (PAGE_ENABLE_DATA)
+		memcpy(ssd.ram.get_data(page), ssd.result_buffer, PAGE_SIZE);
+	return SUCCESS;
+}
+
+/* Buffers the written page.  An overwrite of a buffered page replaces it in
+ * RAM, otherwise room is made first, which may write back the victim. */
+enum status Controller::buffer_write(Event &event)
+{
+	uint32_t page = ssd.ram.find_page(event.get_logical_address());
+
+	if (page != Ram::BUFFER_NIL)
+	{
+		ssd.ram.touch_page(page);
+		ssd.ram.set_dirty(page, true);
+		stats.numBufferWriteHits++;
+	}
+	else
+	{
+		if (make_room(event) == FAILURE)
+			return FAILURE;
+		page = ssd.ram.insert_page(event.get_logical_address(), event.get_streamID(), true);
+	}
+
+	if (PAGE_ENABLE_DATA && event.get_payload() != NULL)
+		memcpy(ssd.ram.get_data(page), event.get_payload(), PAGE_SIZE);
+	return ssd.ram.write(event);
+}
+
+/* A trimmed page is dropped from the buffer without being written back. */
+enum status Controller::buffer_trim(Event &event)
+{
+	uint32_t page = ssd.ram.find_page(event.get_logical_address());
+
+	if (page != Ram::BUFFER_NIL)
+		ssd.ram.remove_page(page);
+	return ftl->trim(event);
+}
+
+/* Writes dirty pages back from the least recently used unit on, leaving them
+ * buffered as clean pages.  Stops once the event reaches end_time. */
+enum status Controller::flush(Event &event, double end_time)
+{
+	stats.numBufferFlushes++;
+
+	for (uint32_t unit = ssd.ram.get_lru_unit(); unit != Ram::BUFFER_NIL && ssd.ram.get_buffer_dirty() > 0; unit = ssd.ram.get_newer_unit(unit))
+	{
+		ssd.ram.get_unit_pages(unit, unit_pages);
+		for (uint i = 0; i < unit_pages.size(); i++)
+		{
+			if (event.get_start_time() + event.get_time_taken() >= end_time)
+				return SUCCESS;
+			if (ssd.ram.is_dirty(unit_pages[i]) && write_back(unit_pages[i], event) == FAILURE)
+				return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+/* Evicts units until a page is free.  The dirty pages of a unit are written
+ * back in logical page order before it is dropped. */
+enum status Controller::make_room(Event &event)
+{
+	while (ssd.ram.get_buffer_used() >= ssd.ram.get_buffer_size())
+	{
+		ssd.ram.get_unit_pages(ssd.ram.get_victim(), unit_pages);
+		for (uint i = 0; i < unit_pages.size(); i++)
+		{
+			if (ssd.ram.is_dirty(unit_pages[i]) && write_back(unit_pages[i], event) == FAILURE)
+				return FAILURE;
+			ssd.ram.remove_page(unit_pages[i]);
+		}
+	}
+	return SUCCESS;
+}
+
+/* Writes the buffered page to flash through the FTL after the event and
+ * charges the write to the event. */
+enum status Controller::write_back(uint32_t page, Event &event)
+{
+	Event writeEvent = Event(WRITE, ssd.ram.get_lpn(page), 1, event.get_start_time() + event.get_time_taken(), ssd.ram.get_streamID(page));
+	writeEvent.set_payload(ssd.ram.get_data(page));
+
+	if (ftl->write(writeEvent) == FAILURE)
+		return FAILURE;
+
+	event.incr_time_taken(writeEvent.get_time_taken());
+	ssd.ram.set_dirty(page, false);
+	stats.numBufferWriteBacks++;
+	return SUCCESS;
+}
+
 enum status Controller::issue(Event &event_list)
 {
+	PROFILE_SCOPE(PROFILE_FLASH);
 	Event *cur;
 
 	/* go through event list and issue each to the hardware
@@ -96,9 +270,9 @@ enum status Controller::issue(Event &event_list)
 		else if(cur -> get_event_type() == READ)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
+			if(ssd.bus.lock(cur -> get_address().package, ssd.clock, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY, *cur) == FAILURE
 				|| ssd.read(*cur) == FAILURE
-				|| ssd.bus.lock(cur -> get_address().package, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
+				|| ssd.bus.lock(cur -> get_address().package, ssd.clock, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
 				|| ssd.ram.write(*cur) == FAILURE
 				|| ssd.ram.read(*cur) == FAILURE
 				|| ssd.replace(*cur) == FAILURE)
@@ -107,7 +281,7 @@ enum status Controller::issue(Event &event_list)
 		else if(cur -> get_event_type() == WRITE)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
+			if(ssd.bus.lock(cur -> get_address().package, ssd.clock, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
 				|| ssd.ram.write(*cur) == FAILURE
 				|| ssd.ram.read(*cur) == FAILURE
 				|| ssd.write(*cur) == FAILURE
@@ -117,7 +291,7 @@ enum status Controller::issue(Event &event_list)
 		else if(cur -> get_event_type() == ERASE)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
+			if(ssd.bus.lock(cur -> get_address().package, ssd.clock, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY, *cur) == FAILURE
 				|| ssd.erase(*cur) == FAILURE)
 				return FAILURE;
 		}
@@ -125,7 +299,7 @@ enum status Controller::issue(Event &event_list)
 		{
 			assert(cur -> get_address().valid > NONE);
 			assert(cur -> get_merge_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
+			if(ssd.bus.lock(cur -> get_address().package, ssd.clock, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY, *cur) == FAILURE
 				|| ssd.merge(*cur) == FAILURE)
 				return FAILURE;
 		}
@@ -215,6 +389,16 @@ const FtlParent &Controller::get_ftl(void) const
 	return (*ftl);
 }
 
+Block_manager &Controller::get_block_manager(void) const
+{
+	return ftl->get_block_manager();
+}
+
+void *Controller::get_page_data(ulong page) const
+{
+	return ssd.get_page_data(page);
+}
+
 // Yoohyuk Lim
 void Controller::print_ftl_statistics(FILE *stream)
 {
@@ -225,3 +409,10 @@ void Controller::print_ftl_statistics()
 {
 	ftl->print_ftl_statistics();
 }
+
+void Controller::snapshot(Snapshot &snapshot)
+{
+	snapshot.value(last_finish);
+	stats.snapshot(snapshot);
+	ftl->snapshot(snapshot);
+}
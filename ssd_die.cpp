@@ -21,7 +21,25 @@
  * Brendan Tauras 2009-11-03
  *
  * The die is the data storage hardware unit that contains planes and is a flash
- * chip.  Dies maintain wear statistics for the FTL. */
+ * chip.  Dies maintain wear statistics for the FTL.
+ *
+ * The die executes one array operation (read, program, erase or merge) at a
+ * time.  The plane adds the operation's delay to the event, then the die
+ * reserves its busy timeline for that delay at the time the event reached the
+ * die and adds the time spent waiting for the die to the event.  Data
+ * transfers are scheduled separately on the bus channel by the controller.
+ *
+ * With multi-plane operations enabled, a read, program or erase on a plane
+ * that is not part of the die's last operation joins that operation when it
+ * is of the same kind, at the same page offset, and reached the die before the
+ * operation started.  The sibling planes then share one slot on the die's
+ * timeline, as with a multi-plane command on the flash chip.
+ *
+ * Without cache mode the page register holds the data of a read until it was
+ * transferred to the controller and cannot take the data of the next program
+ * while a program runs, so the die stays reserved for one page transfer after
+ * each read or program.  In cache mode the cache register takes the next page
+ * during the array operation and transfers overlap array operations. */
 
 #include <new>
 #include <assert.h>
@@ -48,7 +66,15 @@ Die::Die(const Package &parent, Channel &channel, uint die_size, long physical_a
 	erases_remaining(BLOCK_ERASES),
 
 	/* assume hardware created at time 0 and had an implied free erasure */
-	last_erase_time(0.0)
+	last_erase_time(0.0),
+
+	timeline(),
+
+	op_type(READ),
+	op_page(0),
+	op_planes(0),
+	op_start(0.0),
+	op_duration(0.0)
 {
 	uint i;
 
@@ -99,14 +125,24 @@ enum status Die::read(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
-	return data[event.get_address().plane].read(event);
+	double time_taken = event.get_time_taken();
+	enum status status = data[event.get_address().plane].read(event);
+
+	if(status == SUCCESS)
+		schedule(event, event.get_address().plane, event.get_start_time() + time_taken, time_taken);
+	return status;
 }
 
 enum status Die::write(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
-	return data[event.get_address().plane].write(event);
+	double time_taken = event.get_time_taken();
+	enum status status = data[event.get_address().plane].write(event);
+
+	if(status == SUCCESS)
+		schedule(event, event.get_address().plane, event.get_start_time() + time_taken, time_taken);
+	return status;
 }
 
 enum status Die::replace(Event &event)
@@ -124,33 +160,132 @@ enum status Die::erase(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
+	double time_taken = event.get_time_taken();
 	enum status status = data[event.get_address().plane].erase(event);
 
 	/* update values if no errors */
 	if(status == SUCCESS)
+	{
+		schedule(event, event.get_address().plane, event.get_start_time() + time_taken, time_taken);
 		update_wear_stats(event.get_address());
+	}
 	return status;
 }
 
-/* TODO: move Plane::_merge() to Die and make generic to handle merge across
- * 	both cases: 2 separate planes or within 1 plane */
+/* merges within one plane are done by the plane, merges across two planes
+ * by the die */
 enum status Die::merge(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE && event.get_merge_address().plane < size && event.get_merge_address().valid > DIE);
+	double time_taken = event.get_time_taken();
+	enum status status;
 	if(event.get_address().plane != event.get_merge_address().plane)
-		return _merge(event);
-	else return data[event.get_address().plane]._merge(event);
+		status = _merge(event);
+	else
+		status = data[event.get_address().plane]._merge(event);
+
+	if(status == SUCCESS)
+	{
+		uint merge_plane = event.get_merge_address().plane;
+		double duration = event.get_time_taken() - time_taken;
+		double sched_time = schedule(event, event.get_address().plane, event.get_start_time() + time_taken, time_taken);
+
+		/* a merge across planes keeps the target plane busy as well */
+		if(sched_time >= 0.0 && merge_plane != event.get_address().plane)
+			(void) data[merge_plane].lock(parent.get_parent().get_clock(), sched_time, duration);
+	}
+	return status;
 }
 
-/* TODO: update stub as per Die::merge() comment above
- * to support Die-level merge operations */
+/* handle a merge between blocks on two planes of the die
+ * 	move event::address valid pages to event::address_merge empty pages
+ * the data of each page is read into the source plane's register and moved
+ * to the target plane's register before it is programmed */
 enum status Die::_merge(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE && event.get_merge_address().plane < size && event.get_merge_address().valid > DIE);
 	assert(event.get_address().plane != event.get_merge_address().plane);
-	return SUCCESS;
+	uint i;
+	uint merge_count = 0;
+	uint merge_avail = 0;
+	uint num_merged = 0;
+	double total_delay = 0;
+
+	const Address &address = event.get_address();
+	const Address &merge_address = event.get_merge_address();
+	Plane &source = data[address.plane];
+	Plane &target = data[merge_address.plane];
+	Block *block = source.get_block_pointer(address);
+	Block *merge_block = target.get_block_pointer(merge_address);
+	uint block_size = block -> get_size();
+	uint merge_block_size = merge_block -> get_size();
+
+	/* how many pages must be moved */
+	merge_count = block -> count_pages(VALID);
+
+	/* how many pages are available */
+	merge_avail = merge_block -> count_pages(EMPTY);
+
+	/* fail if not enough space to do the merge */
+	if(merge_count > merge_avail)
+	{
+		fprintf(stderr, "Die error: %s: Not enough space to merge block %d into block %d\n", __func__, address.block, merge_address.block);
+		return FAILURE;
+	}
+
+	Address read(address);
+	Address write(merge_address);
+	read.page = 0;
+	read.valid = PAGE;
+	write.page = 0;
+	write.valid = PAGE;
+	Event read_event(READ, 0, 1, event.get_start_time(), event.get_streamID());
+	Event write_event(WRITE, 0, 1, event.get_start_time(), event.get_streamID());
+
+	/* calculate merge delay and add to event time
+	 * use i as an error counter */
+	for(i = 0; num_merged < merge_count; read.page++)
+	{
+		read.page = block -> find_page(VALID, read.page);
+		if(read.page >= block_size)
+			break;
+
+		read_event.set_address(read);
+		if(source.read(read_event) == FAILURE)
+		{
+			fprintf(stderr, "Die error: %s: Read for merge block %d into %d failed\n", __func__, address.block, merge_address.block);
+			i++;
+		}
+		block -> invalidate_page(read.page);
+
+		/* source register to target register */
+		total_delay += PLANE_REG_READ_DELAY + PLANE_REG_WRITE_DELAY;
+
+		write.page = merge_block -> find_page(EMPTY, write.page);
+		if(write.page < merge_block_size)
+		{
+			/* Plane::write moves the next free page of the plane on */
+			write_event.set_address(write);
+			if(target.write(write_event) == FAILURE)
+			{
+				fprintf(stderr, "Die error: %s: Write for merge block %d into %d failed\n", __func__, address.block, merge_address.block);
+				i++;
+			}
+			num_merged++;
+		}
+	}
+	total_delay += read_event.get_time_taken() + write_event.get_time_taken();
+	event.incr_time_taken(total_delay);
+
+	if(i == 0)
+		return SUCCESS;
+	else
+	{
+		fprintf(stderr, "Die error: %s: %u failures during merge operation\n", __func__, i);
+		return FAILURE;
+	}
 }
 
 const Package &Die::get_parent(void) const
@@ -158,6 +293,99 @@ const Package &Die::get_parent(void) const
 	return parent;
 }
 
+/* reserve the die and the plane for the array operation that was just added
+ * to the event, starting when the die is free at or after issue_time
+ * 	time_taken is the event's time taken before the operation
+ * noop events have no physical location and do not reserve the die
+ * returns the time the operation starts, -1 if nothing was reserved */
+double Die::schedule(Event &event, uint plane, double issue_time, double time_taken)
+{
+	double duration = event.get_time_taken() - time_taken;
+	enum event_type type = event.get_event_type();
+
+	if(event.get_noop() || duration <= 0.0)
+		return -1.0;
+
+	/* without cache mode the page register is busy with a transfer after
+	 * a read or program */
+	double occupancy = duration;
+	if(!CACHE_MODE_ENABLE && (type == READ || type == WRITE))
+		occupancy += BUS_CTRL_DELAY + BUS_DATA_DELAY;
+
+	/* reservations expire against the Ssd's clock, not against issue_time,
+	 * which runs ahead of it for garbage collection */
+	double now = parent.get_parent().get_clock();
+	double sched_time;
+	if(joins_operation(event, plane, issue_time, duration))
+	{
+		sched_time = op_start;
+		op_planes |= 1ul << plane;
+	}
+	else
+	{
+		sched_time = timeline.lock(now, issue_time, occupancy);
+		op_type = type;
+		op_page = event.get_address().page;
+		op_planes = plane < sizeof(op_planes) * 8 ? 1ul << plane : 0;
+		op_start = sched_time;
+		op_duration = duration;
+	}
+
+	/* planes are only busy while their die is, so the plane is free then */
+	(void) data[plane].lock(now, sched_time, occupancy);
+
+	if(FlashTrace::is_enabled())
+	{
+		switch(type)
+		{
+			case READ:
+				FlashTrace::record(FlashTrace::FLASH_READ, sched_time, duration, event);
+				break;
+			case WRITE:
+				FlashTrace::record(FlashTrace::FLASH_PROGRAM, sched_time, duration, event);
+				break;
+			case ERASE:
+				FlashTrace::record(FlashTrace::FLASH_ERASE, sched_time, duration, event);
+				break;
+			case MERGE:
+				FlashTrace::record(FlashTrace::FLASH_MERGE, sched_time, duration, event);
+				break;
+			default:
+				break;
+		}
+	}
+
+	event.incr_time_taken(sched_time - issue_time);
+	return sched_time;
+}
+
+/* whether the operation can run on the plane together with the die's last
+ * operation as a multi-plane operation */
+bool Die::joins_operation(const Event &event, uint plane, double issue_time, double duration) const
+{
+	enum event_type type = event.get_event_type();
+
+	if(!MULTI_PLANE_ENABLE || op_planes == 0 || plane >= sizeof(op_planes) * 8)
+		return false;
+	if(type != op_type || (type != READ && type != WRITE && type != ERASE))
+		return false;
+	if((op_planes & (1ul << plane)) != 0)
+		return false;
+
+	/* sibling planes program and read the same page offset */
+	if(type != ERASE && event.get_address().page != op_page)
+		return false;
+
+	/* the data must be in the register before the operation starts */
+	return issue_time <= op_start && duration == op_duration;
+}
+
+/* latest time the die is busy until, -1 if it was never used */
+double Die::ready_time(void) const
+{
+	return timeline.ready_time();
+}
+
 /* if given a valid Block address, call the Block's method
  * else return local value */
 double Die::get_last_erase_time(const Address &address) const
@@ -251,3 +479,18 @@ Block *Die::get_block_pointer(const Address & address)
 	assert(address.valid >= PLANE);
 	return data[address.plane].get_block_pointer(address);
 }
+
+void Die::snapshot(Snapshot &snapshot)
+{
+	snapshot.value(least_worn);
+	snapshot.value(erases_remaining);
+	snapshot.value(last_erase_time);
+	timeline.snapshot(snapshot);
+	snapshot.value(op_type);
+	snapshot.value(op_page);
+	snapshot.value(op_planes);
+	snapshot.value(op_start);
+	snapshot.value(op_duration);
+	for (uint i = 0; i < size; i++)
+		data[i].snapshot(snapshot);
+}
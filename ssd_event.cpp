@@ -71,10 +71,11 @@ void Event::consolidate_metaevent(Event &list)
 	assert(start_time >= 0);
 
 	/* find max time taken with respect to this event's start_time */
-	max = start_time - list.start_time + list.time_taken;
+	max = list.start_time + list.time_taken - start_time;
+	bus_wait_time += list.bus_wait_time;
 	for(cur = list.next; cur != NULL; cur = cur -> next)
 	{
-		tmp = start_time - cur -> start_time + cur -> time_taken;
+		tmp = cur -> start_time + cur -> time_taken - start_time;
 		if(tmp > max)
 			max = tmp;
 		bus_wait_time += cur -> get_bus_wait_time();
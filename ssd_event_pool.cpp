@@ -0,0 +1,126 @@
+/* ssd_event_pool.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Event_pool class
+ *
+ * Slab allocator for the Events that the Ssd creates for every request page.
+ * Events are carved out of large slabs that are kept for the lifetime of the
+ * pool and recycled through a free list threaded through Event::next, so the
+ * request path does not go through malloc.  Chains of events (linked with
+ * Event::set_next) can be returned to the pool in one call.
+ */
+
+#include <new>
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* number of events allocated together when the free list runs dry */
+#define EVENT_POOL_SLAB_SIZE 4096
+
+Event_pool::Event_pool(void):
+	free_events(NULL),
+	slabs(),
+	in_use(0)
+{
+	return;
+}
+
+Event_pool::~Event_pool(void)
+{
+	/* events still in use are owned by whoever allocated them, but the
+	 * memory goes away with the slabs */
+	for (uint i = 0; i < slabs.size(); i++)
+		free(slabs[i]);
+	return;
+}
+
+Event *Event_pool::alloc(enum event_type type, ulong logical_address, uint size, double start_time, uint streamID)
+{
+	if (free_events == NULL)
+		grow();
+
+	Event *event = free_events;
+	free_events = event->next;
+	in_use++;
+
+	return new (event) Event(type, logical_address, size, start_time, streamID);
+}
+
+/* return a single event to the pool
+ * the event must not be part of a chain that is still in use */
+void Event_pool::release(Event *event)
+{
+	assert(event != NULL && in_use > 0);
+
+	event->~Event();
+	event->next = free_events;
+	free_events = event;
+	in_use--;
+	return;
+}
+
+/* return a whole chain of events linked through Event::next to the pool by
+ * splicing it onto the free list */
+void Event_pool::release_list(Event *list)
+{
+	if (list == NULL)
+		return;
+
+	Event *last = list;
+	uint count = 1;
+	while (last->next != NULL)
+	{
+		Event *next = last->next;
+		last->~Event();
+		last = next;
+		count++;
+	}
+	last->~Event();
+
+	assert(in_use >= count);
+	last->next = free_events;
+	free_events = list;
+	in_use -= count;
+	return;
+}
+
+/* number of events handed out and not yet returned */
+ssd::uint Event_pool::get_in_use(void) const
+{
+	return in_use;
+}
+
+void Event_pool::grow(void)
+{
+	Event *slab = (Event *) malloc(EVENT_POOL_SLAB_SIZE * sizeof(Event));
+	if (slab == NULL)
+	{
+		fprintf(stderr, "Event_pool error: %s: could not allocate Event slab\n", __func__);
+		exit(MEM_ERR);
+	}
+	slabs.push_back(slab);
+
+	for (uint i = EVENT_POOL_SLAB_SIZE; i > 0; i--)
+	{
+		slab[i - 1].next = free_events;
+		free_events = &slab[i - 1];
+	}
+	return;
+}
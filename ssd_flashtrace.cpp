@@ -0,0 +1,238 @@
+/* ssd_flashtrace.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* FlashTrace class
+ *
+ * The trace is a JSON array of trace events.  Timestamps and durations are
+ * simulator time units, which the viewers show as microseconds.  Tracks
+ * are numbered per Ssd: die d of package p is track p * PACKAGE_SIZE + d, bus
+ * channel c is FLASH_TRACE_CHANNEL_TRACK + c and garbage collection runs are
+ * on FLASH_TRACE_GC_TRACK.  The track names are written when the trace is
+ * closed.
+ *
+ * Each thread that records gets its own buffer the first time it records.
+ * Buffers stay registered until the trace is closed, so the buffers of
+ * threads that ended, such as RaidSsd workers, are written out by close.
+ * The trace must only be closed while no other thread simulates.
+ */
+
+#include <new>
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* events a thread buffers before writing them out */
+#define FLASH_TRACE_BUFFER_SIZE 65536
+
+/* first track of the bus channels and the garbage collection track */
+#define FLASH_TRACE_CHANNEL_TRACK 10000
+#define FLASH_TRACE_GC_TRACK 20000
+
+std::atomic<bool> FlashTrace::enabled(false);
+std::atomic<ssd::uint> FlashTrace::devices(0);
+std::mutex FlashTrace::lock;
+FILE *FlashTrace::stream = NULL;
+bool FlashTrace::first_event = true;
+ssd::ulong FlashTrace::generation = 0;
+std::vector<FlashTrace::Buffer *> FlashTrace::buffers;
+
+namespace {
+
+/* the Ssd the thread simulates and whether it is collecting garbage */
+thread_local uint current_device = 0;
+thread_local uint gc_depth = 0;
+
+/* the thread's buffer, valid while its generation is the trace's */
+thread_local void *thread_buffer = NULL;
+thread_local ulong thread_generation = 0;
+
+const char *operation_names[] = {"transfer", "read", "program", "erase", "merge", "garbage collection"};
+
+}
+
+void FlashTrace::open(const char *path)
+{
+	close();
+
+	std::lock_guard<std::mutex> guard(lock);
+	if ((stream = fopen(path, "w")) == NULL)
+	{
+		fprintf(stderr, "FlashTrace error: %s: could not create trace file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+	fprintf(stream, "[\n");
+	first_event = true;
+	generation++;
+	enabled.store(true);
+}
+
+/* Writes out every buffer and the track names and closes the trace */
+void FlashTrace::close(void)
+{
+	if (!enabled.load())
+		return;
+	enabled.store(false);
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (uint i = 0; i < buffers.size(); i++)
+	{
+		flush(*buffers[i]);
+		delete buffers[i];
+	}
+	buffers.clear();
+
+	uint count = devices.load();
+	for (uint device = 0; device < count; device++)
+	{
+		for (uint package = 0; package < SSD_SIZE; package++)
+		{
+			for (uint die = 0; die < PACKAGE_SIZE; die++)
+				fprintf(stream, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"package %u die %u\"}}",
+					first_event ? "" : ",\n", device, package * PACKAGE_SIZE + die, package, die), first_event = false;
+			fprintf(stream, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"channel %u\"}}",
+				device, FLASH_TRACE_CHANNEL_TRACK + package, package);
+		}
+		fprintf(stream, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"garbage collection\"}}",
+			first_event ? "" : ",\n", device, FLASH_TRACE_GC_TRACK);
+		fprintf(stream, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"ssd %u\"}}", device, device);
+		first_event = false;
+	}
+
+	fprintf(stream, "\n]\n");
+	fclose(stream);
+	stream = NULL;
+}
+
+/* Number for a new Ssd, its process in the trace */
+ssd::uint FlashTrace::new_device(void)
+{
+	return devices.fetch_add(1);
+}
+
+/* The Ssd that the calling thread simulates from now on */
+void FlashTrace::set_device(uint device)
+{
+	current_device = device;
+}
+
+/* Operations recorded between begin_gc and end_gc are garbage collection */
+void FlashTrace::begin_gc(void)
+{
+	gc_depth++;
+}
+
+void FlashTrace::end_gc(void)
+{
+	assert(gc_depth > 0);
+	gc_depth--;
+}
+
+/* Records an operation on the hardware the event addresses */
+void FlashTrace::record(enum operation operation, double start, double duration, const Event &event)
+{
+	const Address &address = event.get_address();
+	Record record;
+
+	record.start = start;
+	record.duration = duration;
+	record.operation = operation;
+	record.gc = gc_depth > 0;
+	record.streamID = event.get_streamID();
+	record.device = current_device;
+	record.package = address.package;
+	record.die = address.die;
+	record.plane = address.plane;
+	record.block = address.block;
+	record.page = address.page;
+	record.logical_address = event.get_logical_address();
+	append(record);
+}
+
+void FlashTrace::record_gc(double start, double duration, uint streamID)
+{
+	Record record;
+
+	record.start = start;
+	record.duration = duration;
+	record.operation = GC_RUN;
+	record.gc = 1;
+	record.streamID = streamID;
+	record.device = current_device;
+	record.package = 0;
+	record.die = 0;
+	record.plane = 0;
+	record.block = 0;
+	record.page = 0;
+	record.logical_address = 0;
+	append(record);
+}
+
+/* The calling thread's buffer, registered on first use */
+FlashTrace::Buffer &FlashTrace::get_buffer(void)
+{
+	if (thread_buffer == NULL || thread_generation != generation)
+	{
+		Buffer *buffer = new Buffer;
+		buffer->records.reserve(FLASH_TRACE_BUFFER_SIZE);
+
+		std::lock_guard<std::mutex> guard(lock);
+		buffer->generation = generation;
+		buffers.push_back(buffer);
+		thread_buffer = buffer;
+		thread_generation = generation;
+	}
+	return *(Buffer *) thread_buffer;
+}
+
+void FlashTrace::append(const Record &record)
+{
+	Buffer &buffer = get_buffer();
+
+	buffer.records.push_back(record);
+	if (buffer.records.size() == FLASH_TRACE_BUFFER_SIZE)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		flush(buffer);
+	}
+}
+
+/* Writes out the buffer, the caller holds the lock */
+void FlashTrace::flush(Buffer &buffer)
+{
+	for (uint i = 0; i < buffer.records.size(); i++)
+	{
+		const Record &record = buffer.records[i];
+		const char *separator = first_event ? "" : ",\n";
+		const char *category = record.gc ? "gc" : "host";
+		first_event = false;
+
+		if (record.operation == GC_RUN)
+			fprintf(stream, "%s{\"name\":\"%s\",\"cat\":\"gc\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"stream\":%u}}",
+				separator, operation_names[record.operation], record.start, record.duration, record.device, FLASH_TRACE_GC_TRACK, record.streamID);
+		else if (record.operation == BUS_TRANSFER)
+			fprintf(stream, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"package\":%u,\"stream\":%u,\"lpn\":%lu}}",
+				separator, operation_names[record.operation], category, record.start, record.duration, record.device, FLASH_TRACE_CHANNEL_TRACK + record.package,
+				record.package, record.streamID, record.logical_address);
+		else
+			fprintf(stream, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"package\":%u,\"die\":%u,\"plane\":%u,\"block\":%u,\"page\":%u,\"stream\":%u,\"lpn\":%lu}}",
+				separator, operation_names[record.operation], category, record.start, record.duration, record.device, record.package * PACKAGE_SIZE + record.die,
+				record.package, record.die, record.plane, record.block, record.page, record.streamID, record.logical_address);
+	}
+	buffer.records.clear();
+}
@@ -25,13 +25,8 @@
 
 using namespace ssd;
 
-// Initialization of the block layer.
-Block_manager *Block_manager::inst = NULL;
-
-FtlParent::FtlParent(Controller &controller) : controller(controller)
+FtlParent::FtlParent(Controller &controller) : controller(controller), manager(this)
 {
-	Block_manager::instance_initialize(this);
-
 	printf("Number of total blocks: %u\n", NUMBER_OF_TOTAL_BLOCKS);
 	printf("Number of addressable blocks: %u\n", NUMBER_OF_ADDRESSABLE_BLOCKS);
 	printf("Number of addressable pages: %u\n", NUMBER_OF_ADDRESSABLE_PAGES);
@@ -64,6 +59,11 @@ Block *FtlParent::get_block_pointer(const Address &address)
 	return controller.get_block_pointer(address);
 }
 
+Block_manager &FtlParent::get_block_manager(void)
+{
+	return manager;
+}
+
 void FtlParent::cleanup_block(Event &event, Block *block)
 {
 	assert(false);
@@ -79,3 +79,20 @@ void FtlParent::print_ftl_statistics()
 {
 	print_ftl_statistics(stdout);
 }
+
+/* FTLs that keep their state out of the snapshot cannot be restored */
+void FtlParent::snapshot(Snapshot &snapshot)
+{
+	fprintf(stderr, "FtlParent error: %s: the FTL does not support snapshots\n", __func__);
+	exit(MEM_ERR);
+}
+
+/* Saves a block pointer as the block's address, or NULL as -1, and turns
+ * the address back into the block when loading */
+void FtlParent::snapshot_block(Snapshot &snapshot, Block *&block)
+{
+	long address = block != NULL ? block->get_physical_address() : -1;
+	snapshot.value(address);
+	if (snapshot.is_loading())
+		block = address != -1 ? get_block_pointer(Address(address, BLOCK)) : NULL;
+}
@@ -220,3 +220,12 @@ Block *Package::get_block_pointer(const Address & address)
 	assert(address.valid >= DIE);
 	return data[address.die].get_block_pointer(address);
 }
+
+void Package::snapshot(Snapshot &snapshot)
+{
+	snapshot.value(least_worn);
+	snapshot.value(erases_remaining);
+	snapshot.value(last_erase_time);
+	for (uint i = 0; i < size; i++)
+		data[i].snapshot(snapshot);
+}
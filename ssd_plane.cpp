@@ -22,11 +22,17 @@
  *
  * The plane is the data storage hardware unit that contains blocks.
  * Plane-level merges are implemented in the plane.  Planes maintain wear
- * statistics for the FTL. */
+ * statistics for the FTL.
+ *
+ * Blocks are created when they are first used.  Until then a block is FREE,
+ * has all pages EMPTY and its full erase count, so queries about it are
+ * answered without creating it.  Start-up time and memory follow the part of
+ * the flash that is used rather than its capacity. */
 
 #include <new>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include "ssd.h"
 
 using namespace ssd;
@@ -34,9 +40,9 @@ using namespace ssd;
 Plane::Plane(const Die &parent, uint plane_size, double reg_read_delay, double reg_write_delay, long physical_address):
 	size(plane_size),
 
-	/* use a const pointer (Block * const data) to use as an array
+	/* use a const pointer (Block ** const data) to use as an array
 	 * but like a reference, we cannot reseat the pointer */
-	data((Block *) malloc(size * sizeof(Block))),
+	data((Block **) malloc(size * sizeof(Block *))),
 
 	parent(parent),
 
@@ -49,9 +55,12 @@ Plane::Plane(const Die &parent, uint plane_size, double reg_read_delay, double r
 	/* assume hardware created at time 0 and had an implied free erasure */
 	last_erase_time(0.0),
 
-	free_blocks(size)
+	free_blocks(size),
+
+	timeline(),
+
+	physical_address(physical_address)
 {
-	uint i, block_size;
 
 	if(reg_read_delay < 0.0)
 	{  
@@ -77,28 +86,14 @@ Plane::Plane(const Die &parent, uint plane_size, double reg_read_delay, double r
 	next_page.page = 0;
 	next_page.valid = PAGE;
 
-	/* new cannot initialize an array with constructor args so
-	 * 	malloc the array
-	 * 	then use placement new to call the constructor for each element
-	 * chose an array over container class so we don't have to rely on anything
-	 * 	i.e. STL's std::vector */
-	/* array allocated in initializer list:
- 	 * data = (Block *) malloc(size * sizeof(Block)); */
+	/* blocks are created by get_block() when first used
+	 * array allocated in initializer list:
+ 	 * data = (Block **) malloc(size * sizeof(Block *)); */
 	if(data == NULL){
 		fprintf(stderr, "Plane error: %s: constructor unable to allocate Block data\n", __func__);
 		exit(MEM_ERR);
 	}
-
-    if (SLC_MLC_ENABLE == true)
-        block_size = MLC_BLOCK_SIZE;
-    else
-        block_size = BLOCK_SIZE;
-    
-
-    for(i = 0; i < size; i++)
-    {
-        (void) new (&data[i]) Block(*this, block_size, BLOCK_ERASES, BLOCK_ERASE_DELAY, physical_address+(i*block_size));
-    }
+	memset(data, 0, size * sizeof(Block *));
 
 	return;
 }
@@ -107,18 +102,61 @@ Plane::~Plane(void)
 {
 	assert(data != NULL);
 	uint i;
-	/* call destructor for each Block array element
+	/* call destructor for each Block that was created
 	 * since we used malloc and placement new */
 	for(i = 0; i < size; i++)
-		data[i].~Block();
+	{
+		if(data[i] != NULL)
+		{
+			data[i] -> ~Block();
+			free(data[i]);
+		}
+	}
 	free(data);
 	return;
 }
 
+/* block size of blocks that have not been used */
+ssd::uint Plane::default_block_size(void)
+{
+	return (SLC_MLC_ENABLE == true) ? MLC_BLOCK_SIZE : BLOCK_SIZE;
+}
+
+/* returns the block, creating it on first use */
+Block *Plane::get_block(uint block)
+{
+	assert(data != NULL && block < size);
+	if(data[block] == NULL)
+	{
+		uint block_size = default_block_size();
+		data[block] = (Block *) malloc(sizeof(Block));
+		if(data[block] == NULL)
+		{
+			fprintf(stderr, "Plane error: %s: unable to allocate Block %u\n", __func__, block);
+			exit(MEM_ERR);
+		}
+		(void) new (data[block]) Block(*this, block_size, BLOCK_ERASES, BLOCK_ERASE_DELAY, physical_address + ((long) block * block_size));
+	}
+	return data[block];
+}
+
+/* reserve the plane's busy timeline for an array operation
+ * returns the time the reservation starts */
+double Plane::lock(double now, double start_time, double duration)
+{
+	return timeline.lock(now, start_time, duration);
+}
+
+/* latest time the plane is busy until, -1 if it was never used */
+double Plane::ready_time(void) const
+{
+	return timeline.ready_time();
+}
+
 enum status Plane::read(Event &event)
 {
 	assert(event.get_address().block < size && event.get_address().valid > PLANE);
-	return data[event.get_address().block].read(event);
+	return get_block(event.get_address().block) -> read(event);
 }
 
 // Yoohyuk Lim
@@ -126,9 +164,10 @@ enum status Plane::write(Event &event)
 {
 	assert(event.get_address().block < size && event.get_address().valid > PLANE && next_page.valid >= BLOCK);
 
-	enum block_state prev = data[event.get_address().block].get_state();
+	Block *block = get_block(event.get_address().block);
+	enum block_state prev = block -> get_state();
 
-	status s = data[event.get_address().block].write(event);
+	status s = block -> write(event);
 
 	if(event.get_address().block == next_page.block) {
 		/* if all blocks in the plane are full and this function fails,
@@ -146,7 +185,7 @@ enum status Plane::write(Event &event)
 		(void) get_next_page(ctype);
     }
 
-	if(prev == FREE && data[event.get_address().block].get_state() != FREE)
+	if(prev == FREE && block -> get_state() != FREE)
 		free_blocks--;
 
 	return s;
@@ -155,7 +194,7 @@ enum status Plane::write(Event &event)
 enum status Plane::replace(Event &event)
 {
 	assert(event.get_address().block < size);
-	return data[event.get_replace_address().block].replace(event);
+	return get_block(event.get_replace_address().block) -> replace(event);
 }
 
 // Yoohyuk Lim
@@ -166,7 +205,7 @@ enum status Plane::replace(Event &event)
 enum status Plane::erase(Event &event)
 {
 	assert(event.get_address().block < size && event.get_address().valid > PLANE);
-	enum status status = data[event.get_address().block]._erase(event);
+	enum status status = get_block(event.get_address().block) -> _erase(event);
 
 	/* update values if no errors */
 	if(status == 1)
@@ -212,18 +251,16 @@ enum status Plane::_merge(Event &event)
 	const Address &merge_address = event.get_merge_address();
 	assert(address.compare(merge_address) >= BLOCK);
 	assert(address.block < size && merge_address.block < size);
-	uint block_size = data[address.block].get_size();
-	uint merge_block_size = data[merge_address.block].get_size();
+	Block *block = get_block(address.block);
+	Block *merge_block = get_block(merge_address.block);
+	uint block_size = block -> get_size();
+	uint merge_block_size = merge_block -> get_size();
 
 	/* how many pages must be moved */
-	for(i = 0; i < block_size; i++)
-		if(data[address.block].get_state(i) == VALID)
-			merge_count++;
+	merge_count = block -> count_pages(VALID);
 	
 	/* how many pages are available */
-	for(i = 0; i < merge_block_size; i++)
-		if(data[merge_address.block].get_state(i) == EMPTY)
-			merge_avail++;
+	merge_avail = merge_block -> count_pages(EMPTY);
 
 	/* fail if not enough space to do the merge */
 	if(merge_count > merge_avail)
@@ -249,15 +286,15 @@ enum status Plane::_merge(Event &event)
 	for(i = 0; num_merged < merge_count && read.page < block_size; read.page++)
 	{
 		/* find next page to read from */
-		if(data[read.block].get_state(read.page) == VALID)
+		if(block -> get_state(read.page) == VALID)
 		{
 			/* read from page and set status to invalid */
-			if(data[read.block].read(read_event) == 0)
+			if(block -> read(read_event) == 0)
 			{
 				fprintf(stderr, "Plane error: %s: Read for merge block %d into %d failed\n", __func__, read.block, write.block);
 				i++;
 			}
-			data[read.block].invalidate_page(read.page);
+			block -> invalidate_page(read.page);
 
 			/* get time taken for read and plane register write
 			 * read event time will accumulate and be added at end */
@@ -267,10 +304,10 @@ enum status Plane::_merge(Event &event)
 			for(; write.page < merge_block_size; write.page++)
 			{
 				/* find next page to write to */
-				if(data[write.block].get_state(write.page) == EMPTY)
+				if(merge_block -> get_state(write.page) == EMPTY)
 				{
 					/* write to page (page::_write() sets status to valid) */
-					if(data[merge_address.block].write(write_event) == 0)
+					if(merge_block -> write(write_event) == 0)
 					{
 						fprintf(stderr, "Plane error: %s: Write for merge block %d into %d failed\n", __func__, address.block, merge_address.block);
 						i++;
@@ -327,7 +364,7 @@ double Plane::get_last_erase_time(const Address &address) const
 {
 	assert(data != NULL);
 	if(address.valid > PLANE && address.block < size)
-		return data[address.block].get_last_erase_time();
+		return data[address.block] != NULL ? data[address.block] -> get_last_erase_time() : 0.0;
 	else
 		return last_erase_time;
 }
@@ -338,7 +375,7 @@ ssd::ulong Plane::get_erases_remaining(const Address &address) const
 {
 	assert(data != NULL);
 	if(address.valid > PLANE && address.block < size)
-		return data[address.block].get_erases_remaining();
+		return data[address.block] != NULL ? data[address.block] -> get_erases_remaining() : BLOCK_ERASES;
 	else
 		return erases_remaining;
 }
@@ -349,13 +386,20 @@ void Plane::update_wear_stats(void)
 {
 	uint i;
 	uint max_index = 0;
-	ulong max = data[0].get_erases_remaining();
+	Address address;
+	address.valid = BLOCK;
+	address.block = 0;
+	ulong max = get_erases_remaining(address);
 	for(i = 1; i < size; i++)
-		if(data[i].get_erases_remaining() > max)
+	{
+		address.block = i;
+		if(get_erases_remaining(address) > max)
 			max_index = i;
+	}
 	least_worn = max_index;
 	erases_remaining = max;
-	last_erase_time = data[max_index].get_last_erase_time();
+	address.block = max_index;
+	last_erase_time = get_last_erase_time(address);
 	return;
 }
 
@@ -372,13 +416,17 @@ void Plane::get_least_worn(Address &address) const
 enum page_state Plane::get_state(const Address &address) const
 {  
 	assert(data != NULL && address.block < size && address.valid >= PLANE);
-	return data[address.block].get_state(address);
+	if(data[address.block] == NULL)
+		return EMPTY;
+	return data[address.block] -> get_state(address);
 }
 
 enum block_state Plane::get_block_state(const Address &address) const
 {
 	assert(data != NULL && address.block < size && address.valid >= PLANE);
-	return data[address.block].get_state();
+	if(data[address.block] == NULL)
+		return FREE;
+	return data[address.block] -> get_state();
 }
 
 //TODO Yoohyuk Lim
@@ -388,11 +436,14 @@ void Plane::get_free_page(Address &address) const
 {
     uint block_size = (SLC_MLC_ENABLE == true) ? MLC_BLOCK_SIZE
                                                : BLOCK_SIZE;
-	assert(data[address.block].get_pages_valid() < block_size);
+    Address block_address(address);
+    block_address.valid = PLANE;
+    uint pages_valid = get_num_valid(block_address);
+	assert(pages_valid < block_size);
     
     long reminder = address.get_linear_address() % block_size;
     
-	address.page = data[address.block].get_pages_valid();
+	address.page = pages_valid;
 	address.valid = PAGE;
 	address.set_linear_address(address.get_linear_address()+ address.page - reminder);
 	return;
@@ -410,10 +461,10 @@ enum status Plane::get_next_page(block_cell_type ctype)
 
     for(uint i = 0; i < size; i++)
 	{
-		if(data[i].get_state() != INACTIVE)
+		if(data[i] == NULL || data[i] -> get_state() != INACTIVE)
 		{
 			next_page.valid = BLOCK;
-			if(data[i].get_next_page(next_page) == SUCCESS)
+			if(get_block(i) -> get_next_page(next_page) == SUCCESS)
 			{
 				next_page.block = i;
 				return SUCCESS;
@@ -434,17 +485,42 @@ ssd::uint Plane::get_num_free(const Address &address) const
 ssd::uint Plane::get_num_valid(const Address &address) const
 {
 	assert(address.valid >= PLANE);
-	return data[address.block].get_pages_valid();
+	if(data[address.block] == NULL)
+		return 0;
+	return data[address.block] -> get_pages_valid();
 }
 
 ssd::uint Plane::get_num_invalid(const Address & address) const
 {
 	assert(address.valid >= PLANE);
-	return data[address.block].get_pages_invalid();
+	if(data[address.block] == NULL)
+		return 0;
+	return data[address.block] -> get_pages_invalid();
 }
 
 Block *Plane::get_block_pointer(const Address & address)
 {
 	assert(address.valid >= PLANE);
-	return data[address.block].get_pointer();
+	return get_block(address.block);
+}
+
+/* Blocks that were never used are left out and stay unallocated */
+void Plane::snapshot(Snapshot &snapshot)
+{
+	snapshot.value(least_worn);
+	snapshot.value(erases_remaining);
+	snapshot.value(last_erase_time);
+	snapshot.value(next_page.block);
+	snapshot.value(next_page.page);
+	snapshot.value(next_page.valid);
+	snapshot.value(free_blocks);
+	timeline.snapshot(snapshot);
+
+	for (uint i = 0; i < size; i++)
+	{
+		bool used = data[i] != NULL;
+		snapshot.value(used);
+		if (used)
+			get_block(i) -> snapshot(snapshot);
+	}
 }
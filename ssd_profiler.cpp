@@ -0,0 +1,119 @@
+/* ssd_profiler.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Profiler class
+ *
+ * Counters of threads that ended stay registered, so the time of RaidSsd
+ * and TraceReader workers is still reported after they are joined.  Ticks
+ * are converted to seconds with the rate the tick counter ran at since the
+ * profile was started, measured against the steady clock.
+ */
+
+#include <new>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+#ifdef SSD_PROFILE
+
+thread_local Profiler::Timer *Profiler::active = NULL;
+thread_local Profiler::Counters *Profiler::local = NULL;
+std::mutex Profiler::lock;
+std::vector<Profiler::Counters *> Profiler::counters;
+uint64_t Profiler::start_ticks = Profiler::now();
+std::chrono::steady_clock::time_point Profiler::start_time = std::chrono::steady_clock::now();
+
+namespace {
+
+const char *section_names[PROFILE_SECTIONS] = {"FTL mapping", "Flash operations", "Channel scheduling", "GC selection", "Trace parsing"};
+
+}
+
+/* Counts a request serviced by an Ssd */
+void Profiler::count_event(void)
+{
+	Counters &c = get_counters();
+	c.events.store(c.events.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/* Clears the counters of every thread and starts the wall clock over */
+void Profiler::reset(void)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	for (uint i = 0; i < counters.size(); i++)
+	{
+		for (uint s = 0; s < PROFILE_SECTIONS; s++)
+		{
+			counters[i]->ticks[s].store(0, std::memory_order_relaxed);
+			counters[i]->calls[s].store(0, std::memory_order_relaxed);
+		}
+		counters[i]->events.store(0, std::memory_order_relaxed);
+	}
+	start_ticks = now();
+	start_time = std::chrono::steady_clock::now();
+}
+
+void Profiler::print(FILE *stream)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	uint64_t ticks[PROFILE_SECTIONS] = {0};
+	uint64_t calls[PROFILE_SECTIONS] = {0};
+	uint64_t events = 0;
+
+	for (uint i = 0; i < counters.size(); i++)
+	{
+		for (uint s = 0; s < PROFILE_SECTIONS; s++)
+		{
+			ticks[s] += counters[i]->ticks[s].load(std::memory_order_relaxed);
+			calls[s] += counters[i]->calls[s].load(std::memory_order_relaxed);
+		}
+		events += counters[i]->events.load(std::memory_order_relaxed);
+	}
+
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	double rate = wall > 0.0 ? (now() - start_ticks) / wall : 1.0;
+
+	fprintf(stream, "Simulator profile:\n");
+	fprintf(stream, "Wall clock: %f s\t Requests: %lu\t Requests/s: %f\n", wall, (ulong) events, wall > 0.0 ? events / wall : 0.0);
+	fprintf(stream, "%-20s %12s %12s %8s %12s\n", "Section", "Seconds", "Calls", "Wall %", "ns/call");
+	for (uint s = 0; s < PROFILE_SECTIONS; s++)
+	{
+		double seconds = ticks[s] / rate;
+		fprintf(stream, "%-20s %12.6f %12lu %8.2f %12.1f\n", section_names[s], seconds, (ulong) calls[s],
+			wall > 0.0 ? 100.0 * seconds / wall : 0.0, calls[s] > 0 ? seconds * 1e9 / calls[s] : 0.0);
+	}
+}
+
+/* Creates the calling thread's counters on its first measurement */
+Profiler::Counters &Profiler::register_thread(void)
+{
+	Counters *c = new Counters;
+	for (uint s = 0; s < PROFILE_SECTIONS; s++)
+	{
+		c->ticks[s].store(0);
+		c->calls[s].store(0);
+	}
+	c->events.store(0);
+
+	std::lock_guard<std::mutex> guard(lock);
+	counters.push_back(c);
+	local = c;
+	return *c;
+}
+
+#endif
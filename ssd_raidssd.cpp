@@ -19,12 +19,30 @@
  * Matias Bjørling 2012-01-09
  *
  * The Raid SSD is responsible for raiding multiple SSDs together using different mapping techniques.
+ *
+ * Layout: the array is cut into stripes of data_members chunks of
+ * RAID_CHUNK_SIZE pages.  Page o of every chunk of a stripe forms a stripe
+ * row whose parity is page o of the parity chunks.  Parity rotates over the
+ * SSDs from stripe to stripe (left symmetric) and the data chunks of a
+ * stripe follow its parity chunks.  RAID-5 parity P is the xor of the row,
+ * RAID-6 adds Q, the sum of the row weighted by powers of 2 in GF(2^8).
+ *
+ * Writes that cover whole stripes compute parity from the new data alone.
+ * Other writes first read the old data and parity of the rows they touch
+ * and then write the new data and parity (read-modify-write).  Parity pages
+ * are written through the parity stream.  Trims only reach the SSDs for
+ * whole stripes, as trimming part of a stripe would leave its parity stale.
+ *
+ * Every SSD is only ever simulated by one thread, SSD m by worker
+ * m % threads, so the SSDs need no locking.
  */
 
 #include <cmath>
 #include <new>
+#include <algorithm>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include "ssd.h"
 #include <sys/mman.h>
 #include <stdlib.h>
@@ -34,30 +52,119 @@
 
 using namespace ssd;
 
+namespace {
+
+/* log and antilog tables of GF(2^8) with the polynomial 0x11d */
+struct GaloisField
+{
+	uint8_t exp[512];
+	uint8_t log[256];
+
+	GaloisField(void)
+	{
+		uint x = 1;
+		for (uint i = 0; i < 255; i++)
+		{
+			exp[i] = x;
+			exp[i + 255] = x;
+			log[x] = i;
+			x <<= 1;
+			if (x & 0x100)
+				x ^= 0x11d;
+		}
+		exp[510] = exp[0];
+		exp[511] = exp[1];
+		log[0] = 0;
+	}
+};
+
+const GaloisField &galois_field(void)
+{
+	static const GaloisField field;
+	return field;
+}
+
+/* parity ^= coefficient * data, with coefficient 2^power in GF(2^8) */
+void add_parity(char *parity, const char *data, const char *old, uint power)
+{
+	const GaloisField &gf = galois_field();
+
+	for (uint i = 0; i < PAGE_SIZE; i++)
+	{
+		uint8_t delta = (uint8_t) data[i] ^ (old != NULL ? (uint8_t) old[i] : 0);
+		if (delta != 0 && power != 0)
+			delta = gf.exp[gf.log[delta] + power % 255];
+		parity[i] ^= delta;
+	}
+}
+
+}
+
 /* use caution when editing the initialization list - initialization actually
  * occurs in the order of declaration in the class definition and not in the
  * order listed here */
 RaidSsd::RaidSsd(uint ssd_size):
-	size(ssd_size)
+	size(ssd_size),
+	result_buffer(NULL),
+	members(RAID_NUMBER_OF_PHYSICAL_SSDS),
+	parity_members(RAID_LEVEL == 6 ? 2 : RAID_LEVEL == 5 ? 1 : 0),
+	data_members(members - parity_members),
+	capacity(0),
+	parity_rows(),
+	parity_pages(),
+	scratch(),
+	scratch_used(0),
+	threads(RAID_THREADS),
+	workers(),
+	generation(0),
+	pending(0),
+	stopping(false),
+	phase(0),
+	phase_start(0.0),
+	numFullStripeWrites(0),
+	numReadModifyWrites(0),
+	numParityWrites(0),
+	stats()
 {
-/*
- * Idea
- *
- * Create the instances of the SSDs.
- *
- * Techniques
- *
- * 1. Striping
- * 2. Address splitting.
- * 3. Complete control
- */
-	Ssds = new Ssd[RAID_NUMBER_OF_PHYSICAL_SSDS];
+	if (RAID_LEVEL != 0 && RAID_LEVEL != 5 && RAID_LEVEL != 6)
+	{
+		fprintf(stderr, "RaidSsd error: %s: RAID level %u is not supported, use 0, 5 or 6\n", __func__, RAID_LEVEL);
+		exit(FILE_ERR);
+	}
+	if (members <= parity_members || RAID_CHUNK_SIZE == 0)
+	{
+		fprintf(stderr, "RaidSsd error: %s: RAID-%u needs more than %u SSDs and a chunk size of at least one page\n", __func__, RAID_LEVEL, parity_members);
+		exit(FILE_ERR);
+	}
+
+	/* whole stripes of every SSD hold data */
+	capacity = (ulong) (NUMBER_OF_ADDRESSABLE_PAGES / RAID_CHUNK_SIZE) * RAID_CHUNK_SIZE * data_members;
+
+	Ssds = new Ssd[members];
+	ops[0].resize(members);
+	ops[1].resize(members);
+
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	threads = std::max(1u, std::min(threads, members));
+
+	for (uint i = 1; i < threads; i++)
+		workers.push_back(std::thread(&RaidSsd::worker_main, this, i));
 
 	return;
 }
 
 RaidSsd::~RaidSsd(void)
 {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	work_ready.notify_all();
+	for (uint i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	delete[] Ssds;
 	return;
 }
 
@@ -74,49 +181,389 @@ double RaidSsd::event_arrive(enum event_type type, ulong logical_address, uint s
  * 	request.  Remember to use the same time units as in the config file. */
 double RaidSsd::event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer)
 {
-	if (type == WRITE)
-		printf("Writing to logical address: %lu\n", logical_address);
-	else if (type == READ)
-		printf("Read from logical address: %lu\n", logical_address);
+	assert(start_time >= 0.0 && size > 0);
+	assert(type == FLUSH || logical_address + size <= capacity);
+
+	for (uint m = 0; m < members; m++)
+	{
+		ops[0][m].clear();
+		ops[1][m].clear();
+	}
+	parity_rows.clear();
+	parity_pages.clear();
+	scratch_used = 0;
+
+	/* every row a write touches holds at least one page of it, so the old
+	 * data, old parity and new parity of the rows fit in this */
+	if (PAGE_ENABLE_DATA && buffer != NULL && type == WRITE && parity_members > 0)
+	{
+		ulong pages = (ulong) size * (1 + 2 * parity_members);
+		if (scratch.size() < pages * PAGE_SIZE)
+			scratch.resize(pages * PAGE_SIZE);
+	}
+	else
+		scratch.clear();
 
-	if (PARALLELISM_MODE == 1) // Striping
+	if (type == WRITE && parity_members > 0)
+		plan_write(logical_address, size, (char *) buffer);
+	else if (type == TRIM && parity_members > 0)
+		plan_trim(logical_address, size);
+	else if (type == FLUSH)
+	{
+		for (uint m = 0; m < members; m++)
+			add_op(1, m, FLUSH, 0, NULL, STREAMID_DEFAULT, NULL);
+	}
+	else
 	{
-		double timings[RAID_NUMBER_OF_PHYSICAL_SSDS];
-		for (uint i=0;i<RAID_NUMBER_OF_PHYSICAL_SSDS;i++)
+		for (uint i = 0; i < size; i++)
 		{
-			if (buffer == NULL)
+			uint member;
+			ulong member_address;
+			map_page(logical_address + i, member, member_address);
+			add_op(1, member, type, member_address, buffer == NULL ? NULL : (char *) buffer + (ulong) i * PAGE_SIZE, STREAMID_DEFAULT, NULL);
+		}
+	}
+
+	double read_time = run_phase(0, start_time);
+	compute_parity();
+	double time = read_time + run_phase(1, start_time + read_time);
+	stats.record_latency(type, STREAMID_DEFAULT, time);
+
+	if (type == READ)
+	{
+		uint member;
+		ulong member_address;
+		map_page(logical_address + size - 1, member, member_address);
+		result_buffer = Ssds[member].get_result_buffer();
+	}
+	return time;
+}
+
+/*
+ * Returns a pointer to the global buffer of the Ssd.
+ * It is up to the user to not read out of bound and only
+ * read the intended size. i.e. the page size.
+ */
+void *RaidSsd::get_result_buffer()
+{
+	return result_buffer;
+}
+
+/* Number of pages the array holds */
+ssd::ulong RaidSsd::get_capacity(void) const
+{
+	return capacity;
+}
+
+void RaidSsd::print_statistics()
+{
+	printf("RAID-%u array of %u SSDs, chunk size %u pages\n", RAID_LEVEL, members, RAID_CHUNK_SIZE);
+	printf("Full stripe writes: %li Read-modify-writes: %li Parity writes: %li\n", numFullStripeWrites, numReadModifyWrites, numParityWrites);
+	printf("Array requests:\n");
+	stats.print_latency();
+	for (uint m = 0; m < members; m++)
+	{
+		printf("SSD %u:\n", m);
+		Ssds[m].controller.stats.print_statistics();
+	}
+#ifdef SSD_PROFILE
+	Profiler::print(stdout);
+#endif
+}
+
+void RaidSsd::reset_statistics()
+{
+	numFullStripeWrites = 0;
+	numReadModifyWrites = 0;
+	numParityWrites = 0;
+	stats.reset_statistics();
+	for (uint m = 0; m < members; m++)
+		Ssds[m].reset_statistics();
+}
+
+/* latency of the array requests, in the format of Ssd::write_latency */
+void RaidSsd::write_latency(FILE *stream)
+{
+	stats.write_latency(stream);
+}
+
+void RaidSsd::print_ftl_statistics()
+{
+	for (uint m = 0; m < members; m++)
+		Ssds[m].print_ftl_statistics();
+}
+
+/* SSD holding parity chunk 0 (P) or 1 (Q) of the stripe */
+ssd::uint RaidSsd::parity_member(ulong stripe, uint parity) const
+{
+	return (members - 1 - stripe % members + parity) % members;
+}
+
+/* SSD holding data chunk index of the stripe */
+ssd::uint RaidSsd::data_member(ulong stripe, uint index) const
+{
+	if (parity_members == 0)
+		return index;
+	return (parity_member(stripe, 0) + parity_members + index) % members;
+}
+
+void RaidSsd::map_page(ulong logical_address, uint &member, ulong &member_address) const
+{
+	ulong chunk = logical_address / RAID_CHUNK_SIZE;
+	ulong stripe = chunk / data_members;
+
+	member = data_member(stripe, chunk % data_members);
+	member_address = stripe * RAID_CHUNK_SIZE + logical_address % RAID_CHUNK_SIZE;
+}
+
+/* Queues a single page request to the SSD.  It joins the previous request
+ * to the SSD when it continues it, so runs of pages within a chunk reach
+ * the SSD as one multi-page request. */
+void RaidSsd::add_op(uint phase, uint member, enum event_type type, ulong logical_address, void *payload, uint streamID, char *result)
+{
+	std::vector<RaidOp> &list = ops[phase][member];
+
+	if (!list.empty() && result == NULL && type != FLUSH)
+	{
+		RaidOp &last = list.back();
+		if (last.type == type && last.streamID == streamID && last.result == NULL
+			&& last.logical_address + last.size == logical_address
+			&& (payload == NULL ? last.payload == NULL : last.payload != NULL && (char *) last.payload + (ulong) last.size * PAGE_SIZE == payload))
+		{
+			last.size++;
+			return;
+		}
+	}
+
+	RaidOp op;
+	op.type = type;
+	op.logical_address = logical_address;
+	op.size = 1;
+	op.payload = payload;
+	op.streamID = streamID;
+	op.result = result;
+	op.time_taken = 0.0;
+	list.push_back(op);
+}
+
+/* Next scratch page of the request, NULL when pages hold no data */
+char *RaidSsd::scratch_page(void)
+{
+	if (scratch.empty())
+		return NULL;
+	assert((scratch_used + 1) * PAGE_SIZE <= scratch.size());
+	return &scratch[(scratch_used++) * PAGE_SIZE];
+}
+
+/* Queues the data and parity writes of a write, and for stripes it covers
+ * only in part the reads of the old data and parity before them. */
+void RaidSsd::plan_write(ulong logical_address, uint size, char *buffer)
+{
+	ulong end = logical_address + size;
+	ulong stripe_pages = (ulong) RAID_CHUNK_SIZE * data_members;
+	bool data = !scratch.empty();
+
+	for (ulong stripe = logical_address / stripe_pages; stripe * stripe_pages < end; stripe++)
+	{
+		ulong first = std::max(logical_address, stripe * stripe_pages);
+		ulong last = std::min(end, (stripe + 1) * stripe_pages);
+		bool full = first == stripe * stripe_pages && last == (stripe + 1) * stripe_pages;
+
+		if (full)
+			numFullStripeWrites++;
+		else
+			numReadModifyWrites++;
+
+		for (uint row = 0; row < RAID_CHUNK_SIZE; row++)
+		{
+			ulong member_address = stripe * RAID_CHUNK_SIZE + row;
+			ParityRow parity;
+			parity.first = parity_pages.size();
+			parity.count = 0;
+
+			for (uint index = 0; index < data_members; index++)
 			{
-				printf("Executing stage: %i\n", i);
-				timings[i] = Ssds[i].event_arrive(type, logical_address, size, start_time, NULL);
+				ulong page = stripe * stripe_pages + (ulong) index * RAID_CHUNK_SIZE + row;
+				if (page < first || page >= last)
+					continue;
+
+				uint member = data_member(stripe, index);
+				char *payload = data ? buffer + (page - logical_address) * PAGE_SIZE : NULL;
+				char *old = NULL;
+
+				if (!full)
+				{
+					old = scratch_page();
+					add_op(0, member, READ, member_address, NULL, STREAMID_DEFAULT, old);
+				}
+				add_op(1, member, WRITE, member_address, payload, STREAMID_DEFAULT, NULL);
+
+				ParityPage entry;
+				entry.index = index;
+				entry.data = payload;
+				entry.old = old;
+				parity_pages.push_back(entry);
+				parity.count++;
 			}
 
+			if (parity.count == 0)
+				continue;
+
+			for (uint i = 0; i < 2; i++)
+			{
+				parity.parity[i] = NULL;
+				parity.old_parity[i] = NULL;
+			}
+
+			for (uint i = 0; i < parity_members; i++)
+			{
+				uint member = parity_member(stripe, i);
+				if (!full)
+				{
+					parity.old_parity[i] = scratch_page();
+					add_op(0, member, READ, member_address, NULL, STREAMID_PARITY, parity.old_parity[i]);
+				}
+				parity.parity[i] = scratch_page();
+				add_op(1, member, WRITE, member_address, parity.parity[i], STREAMID_PARITY, NULL);
+				numParityWrites++;
+			}
+			parity_rows.push_back(parity);
+		}
+	}
+}
+
+/* Queues the trims of the whole stripes the range covers, data and parity */
+void RaidSsd::plan_trim(ulong logical_address, uint size)
+{
+	ulong end = logical_address + size;
+	ulong stripe_pages = (ulong) RAID_CHUNK_SIZE * data_members;
+
+	for (ulong stripe = (logical_address + stripe_pages - 1) / stripe_pages; (stripe + 1) * stripe_pages <= end; stripe++)
+	{
+		for (uint row = 0; row < RAID_CHUNK_SIZE; row++)
+		{
+			for (uint m = 0; m < members; m++)
+				add_op(1, m, TRIM, stripe * RAID_CHUNK_SIZE + row, NULL, STREAMID_DEFAULT, NULL);
+		}
+	}
+}
+
+/* New parity = old parity + the change of every page written to the row,
+ * or the parity of the new data alone for whole stripes */
+void RaidSsd::compute_parity(void)
+{
+	if (scratch.empty())
+		return;
+
+	for (uint r = 0; r < parity_rows.size(); r++)
+	{
+		ParityRow &row = parity_rows[r];
+		for (uint i = 0; i < parity_members; i++)
+		{
+			if (row.old_parity[i] != NULL)
+				memcpy(row.parity[i], row.old_parity[i], PAGE_SIZE);
 			else
-				timings[i] = Ssds[i].event_arrive(type, logical_address, size, start_time, (char*)buffer +(i*PAGE_SIZE));
+				memset(row.parity[i], 0, PAGE_SIZE);
 
+			for (uint p = row.first; p < row.first + row.count; p++)
+				add_parity(row.parity[i], parity_pages[p].data, parity_pages[p].old, i * parity_pages[p].index);
 		}
+	}
+}
 
-		for (uint i=0;i<RAID_NUMBER_OF_PHYSICAL_SSDS-1;i++)
+/* Simulates the requests of the phase on every SSD, all starting at
+ * start_time, and returns the time taken by the slowest SSD. */
+double RaidSsd::run_phase(uint phase, double start_time)
+{
+	uint busy = 0;
+	for (uint w = 0; w < threads; w++)
+	{
+		for (uint m = w; m < members; m += threads)
 		{
-			if (timings[i] != timings[i+1])
-				fprintf(stderr, "ERROR: Timings are not the same. %lf %lf\n", timings[i], timings[i+1]);
+			if (!ops[phase][m].empty())
+			{
+				busy++;
+				break;
+			}
 		}
+	}
+	if (busy == 0)
+		return 0.0;
+
+	this->phase = phase;
+	phase_start = start_time;
+
+	/* hand the phase to the workers only when more than one has work */
+	if (busy > 1)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			pending = threads - 1;
+			generation++;
+		}
+		work_ready.notify_all();
+
+		run_worker(0);
 
-		return timings[0];
+		std::unique_lock<std::mutex> guard(lock);
+		work_done.wait(guard, [this] { return pending == 0; });
 	}
-	else if (PARALLELISM_MODE == 2) // Splitted address space
+	else
 	{
-		return Ssds[logical_address%RAID_NUMBER_OF_PHYSICAL_SSDS].event_arrive(type, logical_address, size, start_time, (char*)buffer);
+		for (uint m = 0; m < members; m++)
+			run_member(m);
 	}
 
-	return 0;
+	double time = 0.0;
+	for (uint m = 0; m < members; m++)
+		for (uint i = 0; i < ops[phase][m].size(); i++)
+			time = std::max(time, ops[phase][m][i].time_taken);
+	return time;
 }
 
-/*
- * Returns a pointer to the global buffer of the Ssd.
- * It is up to the user to not read out of bound and only
- * read the intended size. i.e. the page size.
- */
-void *RaidSsd::get_result_buffer()
+void RaidSsd::run_member(uint member)
 {
-	return global_buffer;
+	std::vector<RaidOp> &list = ops[phase][member];
+
+	for (uint i = 0; i < list.size(); i++)
+	{
+		RaidOp &op = list[i];
+		op.time_taken = Ssds[member].event_arrive(op.type, op.logical_address, op.size, phase_start, op.payload, op.streamID);
+
+		if (op.result != NULL)
+		{
+			void *data = Ssds[member].get_result_buffer();
+			if (data != NULL)
+				memcpy(op.result, data, PAGE_SIZE);
+			else
+				memset(op.result, 0, PAGE_SIZE);
+		}
+	}
+}
+
+void RaidSsd::run_worker(uint worker)
+{
+	for (uint m = worker; m < members; m += threads)
+		run_member(m);
+}
+
+void RaidSsd::worker_main(uint worker)
+{
+	ulong seen = 0;
+	std::unique_lock<std::mutex> guard(lock);
+
+	for (;;)
+	{
+		work_ready.wait(guard, [this, seen] { return stopping || generation != seen; });
+		if (stopping)
+			return;
+		seen = generation;
+
+		guard.unlock();
+		run_worker(worker);
+		guard.lock();
+
+		if (--pending == 0)
+			work_done.notify_one();
+	}
 }
@@ -24,18 +24,40 @@
  * This is a basic implementation that only provides delay updates to events
  * based on a delay value multiplied by the size (number of pages) needed to
  * be read or written.
+ *
+ * The Ram also holds the controller's write buffer when RAM_BUFFER_SIZE is
+ * set.  Buffered pages and eviction units live in fixed arrays with free
+ * lists and are found through power of two hash tables, so servicing a
+ * request never allocates.  Units are kept on an intrusive LRU list whose
+ * tail is the next eviction candidate.
  */
 
+#include <algorithm>
 #include <assert.h>
 #include <stdio.h>
 #include "ssd.h"
 
 using namespace ssd;
 
+const uint32_t Ram::BUFFER_NIL;
  
-Ram::Ram(double read_delay, double write_delay):
+Ram::Ram(double read_delay, double write_delay, uint buffer_size):
 	read_delay(read_delay),
-	write_delay(write_delay)
+	write_delay(write_delay),
+	buffer_size(buffer_size),
+	unit_size(RAM_BUFFER_POLICY == BUFFER_BPLRU ? BLOCK_SIZE : 1),
+	used(0),
+	dirty(0),
+	buffer_pages(buffer_size),
+	buffer_units(buffer_size),
+	page_hash(),
+	unit_hash(),
+	hash_mask(0),
+	page_free(BUFFER_NIL),
+	unit_free(BUFFER_NIL),
+	lru_head(BUFFER_NIL),
+	lru_tail(BUFFER_NIL),
+	buffer_data(NULL)
 {
 	if(read_delay <= 0)
 	{
@@ -47,11 +69,46 @@ Ram::Ram(double read_delay, double write_delay):
 		fprintf(stderr, "RAM: %s: constructor received negative write delay value\n\tsetting write delay to 0.0\n", __func__);
 		write_delay = 0.0;
 	}
+
+	if (buffer_size == 0)
+		return;
+
+	if (RAM_BUFFER_POLICY > BUFFER_BPLRU)
+	{
+		fprintf(stderr, "RAM error: %s: unknown write buffer policy %u\n", __func__, RAM_BUFFER_POLICY);
+		exit(FILE_ERR);
+	}
+
+	uint32_t hashSize = 1;
+	while (hashSize < buffer_size)
+		hashSize <<= 1;
+	page_hash.assign(hashSize, BUFFER_NIL);
+	unit_hash.assign(hashSize, BUFFER_NIL);
+	hash_mask = hashSize - 1;
+
+	for (uint32_t i = buffer_size; i-- > 0;)
+	{
+		buffer_pages[i].hash_next = page_free;
+		page_free = i;
+		buffer_units[i].hash_next = unit_free;
+		unit_free = i;
+	}
+
+	if (PAGE_ENABLE_DATA)
+	{
+		buffer_data = (char *) malloc((size_t) buffer_size * PAGE_SIZE);
+		if (buffer_data == NULL)
+		{
+			fprintf(stderr, "RAM error: %s: could not allocate write buffer of %u pages\n", __func__, buffer_size);
+			exit(MEM_ERR);
+		}
+	}
 	return;
 }
 
 Ram::~Ram(void)
 {
+	free(buffer_data);
 	return;
 }
 
@@ -68,3 +125,292 @@ enum status Ram::write(Event &event)
 	(void) event.incr_time_taken(write_delay * event.get_size());
 	return SUCCESS;
 }
+
+uint Ram::get_buffer_size(void) const
+{
+	return buffer_size;
+}
+
+uint Ram::get_buffer_used(void) const
+{
+	return used;
+}
+
+uint Ram::get_buffer_dirty(void) const
+{
+	return dirty;
+}
+
+/* Returns the buffered page holding the logical page, or BUFFER_NIL. */
+uint32_t Ram::find_page(ulong lpn) const
+{
+	if (buffer_size == 0)
+		return BUFFER_NIL;
+
+	uint32_t page = page_hash[lpn & hash_mask];
+	while (page != BUFFER_NIL && buffer_pages[page].lpn != lpn)
+		page = buffer_pages[page].hash_next;
+	return page;
+}
+
+uint32_t Ram::find_unit(ulong key) const
+{
+	uint32_t unit = unit_hash[key & hash_mask];
+	while (unit != BUFFER_NIL && buffer_units[unit].key != key)
+		unit = buffer_units[unit].hash_next;
+	return unit;
+}
+
+/* Buffers the logical page, which must not be buffered yet, and makes its
+ * unit the most recently used one.  The buffer must have a free page. */
+uint32_t Ram::insert_page(ulong lpn, uint streamID, bool dirty)
+{
+	assert(used < buffer_size && find_page(lpn) == BUFFER_NIL);
+
+	ulong key = lpn / unit_size;
+	uint32_t unit = find_unit(key);
+	if (unit == BUFFER_NIL)
+	{
+		unit = unit_free;
+		unit_free = buffer_units[unit].hash_next;
+
+		BufferUnit &u = buffer_units[unit];
+		u.key = key;
+		u.pages = BUFFER_NIL;
+		u.count = 0;
+		u.dirty = 0;
+		u.hash_next = unit_hash[key & hash_mask];
+		unit_hash[key & hash_mask] = unit;
+	}
+	else
+		unit_unlink(unit);
+
+	uint32_t page = page_free;
+	page_free = buffer_pages[page].hash_next;
+
+	BufferPage &p = buffer_pages[page];
+	BufferUnit &u = buffer_units[unit];
+	p.lpn = lpn;
+	p.streamID = streamID;
+	p.dirty = dirty;
+	p.unit = unit;
+	p.unit_next = u.pages;
+	u.pages = page;
+	u.count++;
+	p.hash_next = page_hash[lpn & hash_mask];
+	page_hash[lpn & hash_mask] = page;
+
+	used++;
+	if (dirty)
+	{
+		u.dirty++;
+		this->dirty++;
+	}
+
+	/* BPLRU's LRU compensation: a block that has just been filled up to its
+	 * last page was written sequentially and is unlikely to be written again
+	 * soon, so it is the next to go */
+	unit_link(unit, !(RAM_BUFFER_POLICY == BUFFER_BPLRU && u.count == unit_size && lpn % unit_size == unit_size - 1));
+	return page;
+}
+
+/* Drops the page from the buffer, dirty or not, and its unit with it once the
+ * unit is empty. */
+void Ram::remove_page(uint32_t page)
+{
+	BufferPage &p = buffer_pages[page];
+	uint32_t unit = p.unit;
+	BufferUnit &u = buffer_units[unit];
+
+	uint32_t *link = &page_hash[p.lpn & hash_mask];
+	while (*link != page)
+		link = &buffer_pages[*link].hash_next;
+	*link = p.hash_next;
+
+	link = &u.pages;
+	while (*link != page)
+		link = &buffer_pages[*link].unit_next;
+	*link = p.unit_next;
+
+	u.count--;
+	used--;
+	if (p.dirty)
+	{
+		u.dirty--;
+		dirty--;
+	}
+
+	p.hash_next = page_free;
+	page_free = page;
+
+	if (u.count > 0)
+		return;
+
+	unit_unlink(unit);
+
+	link = &unit_hash[u.key & hash_mask];
+	while (*link != unit)
+		link = &buffer_units[*link].hash_next;
+	*link = u.hash_next;
+
+	u.hash_next = unit_free;
+	unit_free = unit;
+	return;
+}
+
+/* Makes the unit of the page the most recently used one. */
+void Ram::touch_page(uint32_t page)
+{
+	uint32_t unit = buffer_pages[page].unit;
+	if (unit == lru_head)
+		return;
+	unit_unlink(unit);
+	unit_link(unit, true);
+	return;
+}
+
+void Ram::set_dirty(uint32_t page, bool dirty)
+{
+	BufferPage &p = buffer_pages[page];
+	if (p.dirty == dirty)
+		return;
+
+	p.dirty = dirty;
+	if (dirty)
+	{
+		buffer_units[p.unit].dirty++;
+		this->dirty++;
+	}
+	else
+	{
+		buffer_units[p.unit].dirty--;
+		this->dirty--;
+	}
+	return;
+}
+
+bool Ram::is_dirty(uint32_t page) const
+{
+	return buffer_pages[page].dirty;
+}
+
+ssd::ulong Ram::get_lpn(uint32_t page) const
+{
+	return buffer_pages[page].lpn;
+}
+
+ssd::uint Ram::get_streamID(uint32_t page) const
+{
+	return buffer_pages[page].streamID;
+}
+
+/* Data of the buffered page, or NULL when pages hold no data */
+void *Ram::get_data(uint32_t page) const
+{
+	if (buffer_data == NULL)
+		return NULL;
+	return buffer_data + (size_t) page * PAGE_SIZE;
+}
+
+/* Returns the unit to evict next.  CFLRU takes the least recently used clean
+ * unit among the last RAM_BUFFER_CLEAN_WINDOW ones if there is one, as
+ * evicting it costs no flash write. */
+uint32_t Ram::get_victim(void) const
+{
+	if (RAM_BUFFER_POLICY == BUFFER_CFLRU)
+	{
+		uint32_t unit = lru_tail;
+		for (uint i = 0; i < RAM_BUFFER_CLEAN_WINDOW && unit != BUFFER_NIL; i++)
+		{
+			if (buffer_units[unit].dirty == 0)
+				return unit;
+			unit = buffer_units[unit].lru_prev;
+		}
+	}
+	return lru_tail;
+}
+
+uint32_t Ram::get_lru_unit(void) const
+{
+	return lru_tail;
+}
+
+/* Returns the next more recently used unit, or BUFFER_NIL. */
+uint32_t Ram::get_newer_unit(uint32_t unit) const
+{
+	return buffer_units[unit].lru_prev;
+}
+
+/* Collects the pages of the unit in logical page order, which is the order
+ * they are written back in. */
+void Ram::get_unit_pages(uint32_t unit, std::vector<uint32_t> &pages) const
+{
+	pages.clear();
+	for (uint32_t page = buffer_units[unit].pages; page != BUFFER_NIL; page = buffer_pages[page].unit_next)
+		pages.push_back(page);
+
+	const std::vector<BufferPage> &entries = buffer_pages;
+	std::sort(pages.begin(), pages.end(), [&entries](uint32_t a, uint32_t b) {
+		return entries[a].lpn < entries[b].lpn;
+	});
+	return;
+}
+
+/* Links the unit at the most recently used end or at the eviction end. */
+void Ram::unit_link(uint32_t unit, bool recent)
+{
+	BufferUnit &u = buffer_units[unit];
+	if (recent)
+	{
+		u.lru_prev = BUFFER_NIL;
+		u.lru_next = lru_head;
+		if (lru_head != BUFFER_NIL)
+			buffer_units[lru_head].lru_prev = unit;
+		else
+			lru_tail = unit;
+		lru_head = unit;
+	}
+	else
+	{
+		u.lru_next = BUFFER_NIL;
+		u.lru_prev = lru_tail;
+		if (lru_tail != BUFFER_NIL)
+			buffer_units[lru_tail].lru_next = unit;
+		else
+			lru_head = unit;
+		lru_tail = unit;
+	}
+	return;
+}
+
+void Ram::unit_unlink(uint32_t unit)
+{
+	BufferUnit &u = buffer_units[unit];
+	if (u.lru_prev != BUFFER_NIL)
+		buffer_units[u.lru_prev].lru_next = u.lru_next;
+	else
+		lru_head = u.lru_next;
+	if (u.lru_next != BUFFER_NIL)
+		buffer_units[u.lru_next].lru_prev = u.lru_prev;
+	else
+		lru_tail = u.lru_prev;
+	return;
+}
+
+/* The write buffer is saved with its contents, dirty pages included */
+void Ram::snapshot(Snapshot &snapshot)
+{
+	snapshot.value(used);
+	snapshot.value(dirty);
+	snapshot.vector(buffer_pages);
+	snapshot.vector(buffer_units);
+	snapshot.vector(page_hash);
+	snapshot.vector(unit_hash);
+	snapshot.value(hash_mask);
+	snapshot.value(page_free);
+	snapshot.value(unit_free);
+	snapshot.value(lru_head);
+	snapshot.value(lru_tail);
+	if (buffer_data != NULL)
+		snapshot.array(buffer_data, (ulong) buffer_size * PAGE_SIZE);
+}
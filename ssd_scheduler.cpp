@@ -0,0 +1,267 @@
+/* ssd_scheduler.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Scheduler class
+ *
+ * Discrete-event core of the simulator.  Requests submitted to the Ssd are
+ * kept in a time-ordered queue (a pairing heap) and serviced in arrival order,
+ * so any number of host requests can be in flight at once.  When a request has
+ * been serviced its completion is queued at its finish time and the
+ * completion callback is called once the simulation reaches that time.
+ *
+ * Servicing arrivals in time order also gives the Ssd a non-decreasing
+ * clock, against which the bus channel and flash timelines expire old
+ * reservations.  The start times the timelines see are not ordered:
+ * garbage collection and other operations a request issues start at the
+ * request's time taken, well ahead of later arrivals.
+ */
+
+#include <new>
+#include <limits>
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* number of queue entries allocated together when the free list runs dry */
+#define SCHEDULER_SLAB_SIZE 1024
+
+Scheduler::Scheduler(Ssd &ssd):
+	ssd(ssd),
+	root(NULL),
+	free_entries(NULL),
+	slabs(),
+	sequence(0),
+	current_time(0.0),
+	in_flight(0)
+{
+	return;
+}
+
+Scheduler::~Scheduler(void)
+{
+	/* drop requests that never completed */
+	while (root != NULL)
+	{
+		Entry *entry = pop();
+		ssd.event_pool.release(entry->event);
+	}
+
+	for (uint i = 0; i < slabs.size(); i++)
+		free(slabs[i]);
+	return;
+}
+
+/* queue a request for servicing at its start (arrival) time
+ * the scheduler takes ownership of the event, which must come from the
+ * Ssd's event pool */
+void Scheduler::submit(Event &event, event_callback callback, void *context)
+{
+	assert(event.get_start_time() >= current_time);
+
+	Entry *entry = alloc();
+	entry->time = event.get_start_time();
+	entry->stage = ARRIVAL;
+	entry->event = &event;
+	entry->callback = callback;
+	entry->context = context;
+	push(entry);
+
+	in_flight++;
+	return;
+}
+
+/* process queued arrivals and completions in time order until the next
+ * queued entry lies beyond the given time
+ * returns the current simulation time */
+double Scheduler::run_until(double time)
+{
+	while (root != NULL && root->time <= time)
+	{
+		Entry *entry = pop();
+		current_time = entry->time;
+
+		if (entry->stage == ARRIVAL)
+		{
+			ssd.stats_log.advance(entry->time);
+			ssd.dispatch(*entry->event);
+			ssd.account(*entry->event);
+
+			/* requeue as a completion at the request's finish time */
+			entry->time = entry->event->get_start_time() + entry->event->get_time_taken();
+			entry->stage = COMPLETION;
+			push(entry);
+		}
+		else
+		{
+			/* the callback may submit further requests */
+			if (entry->callback != NULL)
+				entry->callback(*entry->event, entry->context);
+			ssd.event_pool.release(entry->event);
+			release(entry);
+			in_flight--;
+		}
+	}
+
+	if (time > current_time && time != std::numeric_limits<double>::infinity())
+		current_time = time;
+	return current_time;
+}
+
+/* process everything that is queued, including requests submitted by
+ * completion callbacks */
+double Scheduler::run(void)
+{
+	return run_until(std::numeric_limits<double>::infinity());
+}
+
+/* number of submitted requests that have not completed yet */
+uint Scheduler::get_queue_depth(void) const
+{
+	return in_flight;
+}
+
+double Scheduler::get_current_time(void) const
+{
+	return current_time;
+}
+
+/* only the clock is saved, so requests must not be in flight */
+void Scheduler::snapshot(Snapshot &snapshot)
+{
+	if (root != NULL || in_flight > 0)
+	{
+		fprintf(stderr, "Scheduler error: %s: cannot take a snapshot with %u requests in flight\n", __func__, in_flight);
+		exit(MEM_ERR);
+	}
+	snapshot.value(sequence);
+	snapshot.value(current_time);
+	return;
+}
+
+/* entries are ordered by time, completions before arrivals at the same time
+ * so callbacks observe a consistent queue depth, then by submission order */
+bool Scheduler::before(const Entry *lhs, const Entry *rhs)
+{
+	if (lhs->time != rhs->time)
+		return lhs->time < rhs->time;
+	if (lhs->stage != rhs->stage)
+		return lhs->stage < rhs->stage;
+	return lhs->sequence < rhs->sequence;
+}
+
+Scheduler::Entry *Scheduler::meld(Entry *first, Entry *second)
+{
+	if (first == NULL)
+		return second;
+	if (second == NULL)
+		return first;
+	if (before(second, first))
+	{
+		Entry *tmp = first;
+		first = second;
+		second = tmp;
+	}
+	second->sibling = first->child;
+	first->child = second;
+	return first;
+}
+
+/* standard two-pass pairing: meld siblings pairwise from left to right, then
+ * meld the resulting heaps from right to left */
+Scheduler::Entry *Scheduler::meld_pairs(Entry *list)
+{
+	Entry *pairs = NULL;
+
+	while (list != NULL)
+	{
+		Entry *first = list;
+		Entry *second = first->sibling;
+		if (second == NULL)
+		{
+			first->sibling = pairs;
+			pairs = first;
+			break;
+		}
+		list = second->sibling;
+		first->sibling = NULL;
+		second->sibling = NULL;
+		first = meld(first, second);
+		first->sibling = pairs;
+		pairs = first;
+	}
+
+	Entry *heap = NULL;
+	while (pairs != NULL)
+	{
+		Entry *next = pairs->sibling;
+		pairs->sibling = NULL;
+		heap = meld(heap, pairs);
+		pairs = next;
+	}
+	return heap;
+}
+
+void Scheduler::push(Entry *entry)
+{
+	entry->sequence = sequence++;
+	entry->child = NULL;
+	entry->sibling = NULL;
+	root = meld(root, entry);
+	return;
+}
+
+Scheduler::Entry *Scheduler::pop(void)
+{
+	assert(root != NULL);
+	Entry *top = root;
+	root = meld_pairs(top->child);
+	top->child = NULL;
+	return top;
+}
+
+Scheduler::Entry *Scheduler::alloc(void)
+{
+	if (free_entries == NULL)
+	{
+		Entry *slab = (Entry *) malloc(SCHEDULER_SLAB_SIZE * sizeof(Entry));
+		if (slab == NULL)
+		{
+			fprintf(stderr, "Scheduler error: %s: could not allocate queue entries\n", __func__);
+			exit(MEM_ERR);
+		}
+		slabs.push_back(slab);
+
+		for (uint i = 0; i < SCHEDULER_SLAB_SIZE; i++)
+		{
+			slab[i].sibling = free_entries;
+			free_entries = &slab[i];
+		}
+	}
+
+	Entry *entry = free_entries;
+	free_entries = entry->sibling;
+	return entry;
+}
+
+void Scheduler::release(Entry *entry)
+{
+	entry->sibling = free_entries;
+	free_entries = entry;
+	return;
+}
@@ -0,0 +1,188 @@
+/* ssd_snapshot.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Snapshot class
+ *
+ * A snapshot starts with the magic, the version and the sizes of the basic
+ * types, followed by the configuration values the state depends on.  A
+ * snapshot taken with another geometry, FTL or build is refused instead of
+ * being read as garbage.  Writes go through a large stdio buffer; reads
+ * copy straight out of the mapped file.
+ */
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* stdio buffer of a snapshot being written */
+#define SNAPSHOT_BUFFER_SIZE (1 << 20)
+
+const char Snapshot::MAGIC[8] = {'F', 'S', 'I', 'M', 'S', 'N', 'A', 'P'};
+
+Snapshot::Snapshot(const char *path, bool loading):
+	path(path),
+	loading(loading),
+	file(NULL),
+	fd(-1),
+	data(NULL),
+	size(0),
+	offset(0)
+{
+	if (!loading)
+	{
+		if ((file = fopen(path, "wb")) == NULL)
+		{
+			fprintf(stderr, "Snapshot error: %s: could not create snapshot file %s\n", __func__, path);
+			exit(FILE_ERR);
+		}
+		(void) setvbuf(file, NULL, _IOFBF, SNAPSHOT_BUFFER_SIZE);
+	}
+	else
+	{
+		if ((fd = open(path, O_RDONLY)) == -1)
+		{
+			fprintf(stderr, "Snapshot error: %s: could not open snapshot file %s\n", __func__, path);
+			exit(FILE_ERR);
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) == -1)
+		{
+			fprintf(stderr, "Snapshot error: %s: could not stat snapshot file %s\n", __func__, path);
+			exit(FILE_ERR);
+		}
+		size = info.st_size;
+
+		if (size > 0)
+		{
+			void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map == MAP_FAILED)
+			{
+				fprintf(stderr, "Snapshot error: %s: could not map snapshot file %s\n", __func__, path);
+				exit(MEM_ERR);
+			}
+			(void) madvise(map, size, MADV_SEQUENTIAL);
+			data = (const char *) map;
+		}
+	}
+
+	char magic[sizeof(MAGIC)];
+	uint32_t version = VERSION;
+	uint32_t sizes[4] = {sizeof(uint), sizeof(ulong), sizeof(double), sizeof(enum block_state)};
+	memcpy(magic, MAGIC, sizeof(MAGIC));
+	if (loading && size < sizeof(magic))
+	{
+		fprintf(stderr, "Snapshot error: %s: %s is not a snapshot\n", __func__, path);
+		exit(FILE_ERR);
+	}
+	array(magic, sizeof(magic));
+	if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		fprintf(stderr, "Snapshot error: %s: %s is not a snapshot\n", __func__, path);
+		exit(FILE_ERR);
+	}
+	value(version);
+	array(sizes, 4);
+	if (version != VERSION || sizes[0] != sizeof(uint) || sizes[1] != sizeof(ulong) || sizes[2] != sizeof(double) || sizes[3] != sizeof(enum block_state))
+	{
+		fprintf(stderr, "Snapshot error: %s: snapshot %s was written by another version of the simulator\n", __func__, path);
+		exit(FILE_ERR);
+	}
+}
+
+Snapshot::~Snapshot(void)
+{
+	close();
+}
+
+bool Snapshot::is_loading(void) const
+{
+	return loading;
+}
+
+/* Writes the bytes when saving, overwrites them from the file when loading */
+void Snapshot::transfer(void *values, ulong bytes)
+{
+	if (!loading)
+	{
+		if (fwrite(values, 1, bytes, file) != bytes)
+		{
+			fprintf(stderr, "Snapshot error: %s: could not write snapshot file %s\n", __func__, path);
+			exit(FILE_ERR);
+		}
+		return;
+	}
+
+	if (bytes > size - offset)
+	{
+		fprintf(stderr, "Snapshot error: %s: snapshot file %s is truncated\n", __func__, path);
+		exit(FILE_ERR);
+	}
+	memcpy(values, data + offset, bytes);
+	offset += bytes;
+}
+
+/* Records a configuration value the state depends on, or checks that the
+ * current configuration has the value the snapshot was taken with */
+void Snapshot::config(const char *name, double value)
+{
+	double saved = value;
+	this->value(saved);
+	if (saved != value)
+	{
+		fprintf(stderr, "Snapshot error: %s: snapshot %s was taken with %s %g, the configuration has %g\n", __func__, path, name, saved, value);
+		exit(FILE_ERR);
+	}
+}
+
+/* Flushes a written snapshot, or checks that a loaded one was read to its
+ * end, and releases the file */
+void Snapshot::close(void)
+{
+	if (file != NULL)
+	{
+		bool failed = fflush(file) != 0 || ferror(file);
+		failed = fclose(file) != 0 || failed;
+		file = NULL;
+		if (failed)
+		{
+			fprintf(stderr, "Snapshot error: %s: could not write snapshot file %s\n", __func__, path);
+			exit(FILE_ERR);
+		}
+	}
+	if (fd != -1)
+	{
+		bool complete = offset == size;
+		if (data != NULL)
+			(void) munmap((void *) data, size);
+		(void) ::close(fd);
+		data = NULL;
+		fd = -1;
+		if (!complete)
+		{
+			fprintf(stderr, "Snapshot error: %s: snapshot file %s has %lu bytes past the simulator state\n", __func__, path, size - offset);
+			exit(FILE_ERR);
+		}
+	}
+}
@@ -26,8 +26,10 @@
 
 #include <cmath>
 #include <new>
+#include <limits>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include "ssd.h"
 #include <sys/mman.h>
 #include <stdlib.h>
@@ -46,6 +48,10 @@ Ssd::Ssd(uint ssd_size):
 	controller(*this), 
 	ram(RAM_READ_DELAY, RAM_WRITE_DELAY), 
 	bus(size, BUS_CTRL_DELAY, BUS_DATA_DELAY, BUS_TABLE_SIZE, BUS_MAX_CONNECT), 
+	scheduler(*this), 
+	stats_log(*this),
+	trace_device(FlashTrace::new_device()),
+	clock(0.0),
 
 	/* use a const pointer (Package * const data) to use as an array
 	 * but like a reference, we cannot reseat the pointer */
@@ -60,7 +66,11 @@ Ssd::Ssd(uint ssd_size):
 	least_worn(0), 
 
 	/* assume hardware created at time 0 and had an implied free erasure */
-	last_erase_time(0.0)
+	last_erase_time(0.0),
+
+	page_data(NULL),
+	page_data_size(0),
+	result_buffer(NULL)
 {
 	uint i;
 
@@ -101,12 +111,12 @@ Ssd::Ssd(uint ssd_size):
 	{
         /* Yoohyuk Lim */
 		/* Allocate memory for data pages */
-		ulong pageSize = (ulong)SSD_SIZE * (ulong)physical_address_unit * (ulong)PAGE_SIZE;
+		page_data_size = (ulong)SSD_SIZE * (ulong)physical_address_unit * (ulong)PAGE_SIZE;
 
 #ifdef __APPLE__
-		page_data = mmap(NULL, pageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		page_data = mmap(NULL, page_data_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
 #else
-		page_data = mmap64(NULL, pageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1 ,0);
+		page_data = mmap64(NULL, page_data_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1 ,0);
 #endif
 
 		if (page_data == MAP_FAILED)
@@ -133,6 +143,9 @@ Ssd::Ssd(uint ssd_size):
 
 Ssd::~Ssd(void)
 {
+	/* the last interval still needs the controller */
+	stats_log.close();
+
 	/* explicitly call destructors and use free
 	 * since we used malloc and placement new */
 	for (uint i = 0; i < size; i++)
@@ -140,19 +153,9 @@ Ssd::~Ssd(void)
 		data[i].~Package();
 	}
 	free(data);
-    
-    //Yoohyuk Lim
-    ulong physical_address_unit;
-    if (SLC_MLC_ENABLE == true)
-        physical_address_unit = (ulong)(SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * MLC_BLOCK_SIZE);
-    else
-        physical_address_unit = (ulong)(SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE);
-	
-	if (PAGE_ENABLE_DATA)
-	{
-		ulong pageSize = physical_address_unit * (ulong)PAGE_SIZE;
-		munmap(page_data, pageSize);
-	}
+
+	if (page_data != NULL)
+		munmap(page_data, page_data_size);
 
 	return;
 }
@@ -186,16 +189,6 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
 {
 	assert(start_time >= 0.0);
 
-    if (size != 1)
-    {
-        double d = 0;
-
-        for (uint i=0; i<size; i++)
-            d += event_arrive(type, logical_address + i, 1, start_time + d, buffer == NULL ? NULL : (char *) buffer + (PAGE_SIZE*i), streamID);
-
-        return d;
-    }
-    
     ulong physical_address_size = NUMBER_OF_ADDRESSABLE_PAGES;
 //    if (SLC_MLC_ENABLE == true)
 //        physical_address_size = (ulong)(SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * MLC_BLOCK_SIZE);
@@ -207,28 +200,118 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
 	else
 		assert((long long int) logical_address*VIRTUAL_PAGE_SIZE <= (long long int) physical_address_size);
 
-	/* allocate the event and address dynamically so that the allocator can
-	 * handle efficiency issues for us */
-	Event *event = NULL;
+	/* events come from the Ssd's event pool so that the request path does
+	 * not allocate from the heap */
+	Event *event = event_pool.alloc(type, logical_address , size, start_time, streamID);
 
-	if((event = new Event(type, logical_address , size, start_time, streamID)) == NULL)
+	event->set_payload(buffer);
+
+	/* reads that find no data leave no result */
+	result_buffer = NULL;
+	stats_log.advance(start_time);
+	dispatch(*event);
+	account(*event);
+
+	/* use start_time as a temporary for returning time taken to service event */
+	start_time = event -> get_time_taken();
+	event_pool.release(event);
+	return start_time;
+}
+
+/* Service one request through the controller and leave the time taken in the
+ * event.  Multi-page requests are split into a chain of single page events
+ * from the event pool that all start with the request, so the pages are
+ * spread over the channels and dies as far as the bus and flash timelines
+ * allow.  A page that triggers garbage collection or a translation write
+ * books the dies ahead of the request's start; the later pages still start
+ * with the request, which is safe because the timelines only expire against
+ * the clock set here, never against the start of a page.  The request
+ * finishes with its last page, after which the chain is returned to the pool
+ * together. */
+void Ssd::dispatch(Event &event)
+{
+	/* arrivals from event_arrive may go back in time, the clock does not */
+	if (event.get_start_time() > clock)
+		clock = event.get_start_time();
+
+	if (FlashTrace::is_enabled())
+		FlashTrace::set_device(trace_device);
+
+	if (event.get_size() != 1 && event.get_event_type() != FLUSH)
 	{
-		fprintf(stderr, "Ssd error: %s: could not allocate Event\n", __func__);
-		exit(MEM_ERR);
-	}
+		void *buffer = event.get_payload();
+		Event *list = NULL;
+		Event *last = NULL;
 
-	event->set_payload(buffer);
+		for (uint i=0; i<event.get_size(); i++)
+		{
+			assert((long long int) (event.get_logical_address() + i)*VIRTUAL_PAGE_SIZE <= (long long int) NUMBER_OF_ADDRESSABLE_PAGES);
 
-	if(controller.event_arrive(*event) != SUCCESS)
+			Event *page = event_pool.alloc(event.get_event_type(), event.get_logical_address() + i, 1, event.get_start_time(), event.get_streamID());
+			page->set_payload(buffer == NULL ? NULL : (char *) buffer + (PAGE_SIZE*i));
+
+			if (last == NULL)
+				list = page;
+			else
+				last->set_next(*page);
+			last = page;
+
+			dispatch(*page);
+		}
+
+		event.consolidate_metaevent(*list);
+		event_pool.release_list(list);
+		return;
+	}
+
+	if(controller.event_arrive(event) != SUCCESS)
 	{
 		fprintf(stderr, "Ssd error: %s: request failed:\n", __func__);
-		event -> print(stderr);
+		event.print(stderr);
 	}
+	return;
+}
 
-	/* use start_time as a temporary for returning time taken to service event */
-	start_time = event -> get_time_taken();
-	delete event;
-	return start_time;
+/* Queue a request with the discrete-event scheduler instead of servicing it
+ * right away.  The request is serviced when the simulation reaches its start
+ * time and callback (if any) is called with the finished event when the
+ * simulation reaches its finish time.  Requests may be submitted in any order
+ * as long as they do not start before the current simulation time. */
+void Ssd::submit(enum event_type type, ulong logical_address, uint size, double start_time, event_callback callback, void *context, void *buffer, uint streamID)
+{
+	assert(start_time >= 0.0 && size > 0);
+
+	Event *event = event_pool.alloc(type, logical_address, size, start_time, streamID);
+
+	event->set_payload(buffer);
+	scheduler.submit(*event, callback, context);
+}
+
+/* Advance the simulation to the given time, servicing arrivals and reporting
+ * completions on the way.  Returns the current simulation time. */
+double Ssd::run_until(double time)
+{
+	return scheduler.run_until(time);
+}
+
+/* Run the simulation until no submitted request is left in flight. */
+double Ssd::run(void)
+{
+	return scheduler.run();
+}
+
+/* Number of submitted requests that have not completed yet */
+ssd::uint Ssd::get_queue_depth(void) const
+{
+	return scheduler.get_queue_depth();
+}
+
+/* Latest arrival time serviced.  No operation of a later request can start
+ * before it, so the bus and flash timelines expire the reservations that
+ * finished by then. */
+double Ssd::get_clock(void) const
+{
+	return clock;
 }
 
 /*
@@ -238,7 +321,15 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
  */
 void *Ssd::get_result_buffer()
 {
-	return global_buffer;
+	return result_buffer;
+}
+
+/* Data of the physical page, or NULL when pages hold no data */
+void *Ssd::get_page_data(ulong page) const
+{
+	if (page_data == NULL)
+		return NULL;
+	return (char *) page_data + page * PAGE_SIZE;
 }
 
 /* read write erase and merge should only pass on the event
@@ -249,13 +340,23 @@ void *Ssd::get_result_buffer()
 enum status Ssd::read(Event &event)
 {
 	assert(data != NULL && event.get_address().package < size && event.get_address().valid >= PACKAGE);
-	return data[event.get_address().package].read(event);
+	if (data[event.get_address().package].read(event) == FAILURE)
+		return FAILURE;
+
+	if (page_data != NULL && event.get_noop() == false)
+		result_buffer = get_page_data(event.get_address().get_linear_address());
+	return SUCCESS;
 }
 
 enum status Ssd::write(Event &event)
 {
 	assert(data != NULL && event.get_address().package < size && event.get_address().valid >= PACKAGE);
-	return data[event.get_address().package].write(event);
+	if (data[event.get_address().package].write(event) == FAILURE)
+		return FAILURE;
+
+	if (page_data != NULL && event.get_payload() != NULL && event.get_noop() == false)
+		memcpy(get_page_data(event.get_address().get_linear_address()), event.get_payload(), PAGE_SIZE);
+	return SUCCESS;
 }
 
 enum status Ssd::replace(Event &event)
@@ -380,11 +481,39 @@ ssd::uint Ssd::get_num_invalid(const Address &address) const
 void Ssd::print_statistics()
 {
 	controller.stats.print_statistics();
+#ifdef SSD_PROFILE
+	Profiler::print(stdout);
+#endif
 }
 
 void Ssd::reset_statistics()
 {
 	controller.stats.reset_statistics();
+	stats_log.rebase();
+#ifdef SSD_PROFILE
+	Profiler::reset();
+#endif
+}
+
+/* Write interval statistics to the file at path while the simulation runs,
+ * see StatsLog */
+void Ssd::open_stats_log(const char *path, double interval)
+{
+	stats_log.open(path, interval);
+}
+
+/* Write the last interval and close the interval statistics log */
+void Ssd::close_stats_log(void)
+{
+	stats_log.close();
+}
+
+/* Record a serviced host request in the statistics */
+void Ssd::account(const Event &event)
+{
+	controller.stats.record_latency(event.get_event_type(), event.get_streamID(), event.get_time_taken());
+	stats_log.record(event);
+	PROFILE_EVENT();
 }
 
 void Ssd::write_statistics(FILE *stream)
@@ -392,6 +521,11 @@ void Ssd::write_statistics(FILE *stream)
 	controller.stats.write_statistics(stream);
 }
 
+void Ssd::write_latency(FILE *stream)
+{
+	controller.stats.write_latency(stream);
+}
+
 void Ssd::write_custom_stat(FILE *stream)
 {
 	controller.stats.write_custom_stat(stream);
@@ -424,6 +558,11 @@ const Controller &Ssd::get_controller(void) const
 	return controller;
 }
 
+Block_manager &Ssd::get_block_manager(void) const
+{
+	return controller.get_block_manager();
+}
+
 /**
  * Returns the next ready time. The ready time is the latest point in time when one of the channels are ready to serve new requests.
  */
@@ -448,5 +587,83 @@ double Ssd::ready_at(void)
 /* Yoohyuk Lim */
 void Ssd::print_cost_status(FILE *stream)
 {
-	Block_manager::instance()->print_cost_status(stream);
+	get_block_manager().print_cost_status(stream);
+}
+
+/* Save the state of the Ssd and the simulation time to resume from to the
+ * snapshot file at path, see Snapshot.  No requests may be in flight. */
+void Ssd::save_snapshot(const char *path, double time)
+{
+	Snapshot file(path, false);
+	file.value(time);
+	snapshot(file);
+	file.close();
+}
+
+/* Restore the state saved by save_snapshot into a newly created Ssd of the
+ * same configuration and return the simulation time saved with it */
+double Ssd::load_snapshot(const char *path)
+{
+	double time = 0.0;
+	Snapshot file(path, true);
+	file.value(time);
+	snapshot(file);
+	file.close();
+	return time;
+}
+
+/* The configuration values the saved state depends on are checked, the
+ * delays are not, so experiments can change them after a restore.  Of the
+ * page data only pages that were ever written are saved. */
+void Ssd::snapshot(Snapshot &snapshot)
+{
+	snapshot.config("SSD_SIZE", size);
+	snapshot.config("PACKAGE_SIZE", PACKAGE_SIZE);
+	snapshot.config("DIE_SIZE", DIE_SIZE);
+	snapshot.config("PLANE_SIZE", PLANE_SIZE);
+	snapshot.config("BLOCK_SIZE", BLOCK_SIZE);
+	snapshot.config("BLOCK_ERASES", BLOCK_ERASES);
+	snapshot.config("PAGE_SIZE", PAGE_SIZE);
+	snapshot.config("PAGE_ENABLE_DATA", PAGE_ENABLE_DATA);
+	snapshot.config("MULTI_PLANE_ENABLE", MULTI_PLANE_ENABLE);
+	snapshot.config("MULTISTREAM_LEVEL", MULTISTREAM_LEVEL);
+	snapshot.config("SLC_MLC_ENABLE", SLC_MLC_ENABLE);
+	snapshot.config("SLC_BLOCK_SIZE", SLC_BLOCK_SIZE);
+	snapshot.config("MLC_BLOCK_SIZE", MLC_BLOCK_SIZE);
+	snapshot.config("OVERPROVISIONING_RATIO", OVERPROVISIONING_RATIO);
+	snapshot.config("FTL_IMPLEMENTATION", FTL_IMPLEMENTATION);
+	snapshot.config("CACHE_DFTL_LIMIT", CACHE_DFTL_LIMIT);
+	snapshot.config("RAM_BUFFER_SIZE", ram.get_buffer_size());
+	snapshot.config("RAM_BUFFER_POLICY", RAM_BUFFER_POLICY);
+
+	snapshot.value(erases_remaining);
+	snapshot.value(least_worn);
+	snapshot.value(last_erase_time);
+	snapshot.value(clock);
+	bus.snapshot(snapshot);
+
+	/* blocks are created before the FTL restores its lists of them */
+	for (uint i = 0; i < size; i++)
+		data[i].snapshot(snapshot);
+	ram.snapshot(snapshot);
+	scheduler.snapshot(snapshot);
+	controller.snapshot(snapshot);
+
+	if (page_data != NULL)
+	{
+		std::vector<ulong> written;
+		for (ulong page = 0; !snapshot.is_loading() && page < page_data_size / PAGE_SIZE; page++)
+		{
+			const char *bytes = (const char *) get_page_data(page);
+			for (uint i = 0; i < PAGE_SIZE; i++)
+				if (bytes[i] != 0)
+				{
+					written.push_back(page);
+					break;
+				}
+		}
+		snapshot.vector(written);
+		for (ulong i = 0; i < written.size(); i++)
+			snapshot.transfer(get_page_data(written[i]), PAGE_SIZE);
+	}
 }
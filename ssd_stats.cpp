@@ -25,15 +25,220 @@
 #include <stdio.h>
 #include <math.h>
 #include <iostream>
+#include <algorithm>
 #include "ssd.h"
 
 using namespace ssd;
 
+/* smallest latency the histograms tell apart, in simulator time units */
+#define HISTOGRAM_UNIT 0.001
+
+/* buckets per power of two, a power of two itself */
+#define HISTOGRAM_SUB_BUCKETS 64
+#define HISTOGRAM_SUB_BITS 6
+
+/* request types with a latency histogram, per stream */
+#define LATENCY_TYPES 3
+
+Histogram::Histogram(void):
+	counts(),
+	count(0),
+	sum(0.0),
+	max(0.0)
+{}
+
+/* Bucket of a value of the given number of units: values below twice the
+ * sub-bucket count map to themselves, larger values keep their top
+ * HISTOGRAM_SUB_BITS + 1 bits */
+ssd::uint Histogram::bucket(ulong units)
+{
+	if (units < 2 * HISTOGRAM_SUB_BUCKETS)
+		return units;
+
+	uint shift = 63 - __builtin_clzl(units) - HISTOGRAM_SUB_BITS;
+	return HISTOGRAM_SUB_BUCKETS * shift + (units >> shift);
+}
+
+/* Largest value that falls in the bucket */
+double Histogram::bucket_limit(uint bucket)
+{
+	if (bucket < 2 * HISTOGRAM_SUB_BUCKETS)
+		return (bucket + 1) * HISTOGRAM_UNIT;
+
+	uint shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+	ulong sub = bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+	return (double) ((sub + 1) << shift) * HISTOGRAM_UNIT;
+}
+
+void Histogram::record(double value)
+{
+	if (value < 0.0)
+		value = 0.0;
+
+	uint index = bucket((ulong) (value / HISTOGRAM_UNIT));
+	if (index >= counts.size())
+		counts.resize(index + 1, 0);
+	counts[index]++;
+
+	count++;
+	sum += value;
+	if (value > max)
+		max = value;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+	if (other.counts.size() > counts.size())
+		counts.resize(other.counts.size(), 0);
+	for (uint i = 0; i < other.counts.size(); i++)
+		counts[i] += other.counts[i];
+
+	count += other.count;
+	sum += other.sum;
+	if (other.max > max)
+		max = other.max;
+}
+
+void Histogram::reset(void)
+{
+	counts.clear();
+	count = 0;
+	sum = 0.0;
+	max = 0.0;
+}
+
+ssd::ulong Histogram::get_count(void) const
+{
+	return count;
+}
+
+double Histogram::get_mean(void) const
+{
+	return count > 0 ? sum / count : 0.0;
+}
+
+double Histogram::get_max(void) const
+{
+	return max;
+}
+
+/* Value at or below which the given percent of the values fall, to the
+ * resolution of the buckets */
+double Histogram::percentile(double percent) const
+{
+	if (count == 0)
+		return 0.0;
+
+	ulong rank = (ulong) ceil(percent / 100.0 * count);
+	if (rank < 1)
+		rank = 1;
+
+	ulong seen = 0;
+	for (uint i = 0; i < counts.size(); i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+			return std::min(bucket_limit(i), max);
+	}
+	return max;
+}
+
+/* One line: count, sum, max and the non-empty buckets as bucket:count */
+void Histogram::write(FILE *stream) const
+{
+	fprintf(stream, "%lu %.17g %.17g", count, sum, max);
+	for (uint i = 0; i < counts.size(); i++)
+		if (counts[i] > 0)
+			fprintf(stream, " %u:%lu", i, counts[i]);
+	fprintf(stream, "\n");
+}
+
+/* Reads a line written by write and merges it into the histogram */
+bool Histogram::read(FILE *stream)
+{
+	Histogram other;
+	if (fscanf(stream, "%lu %lf %lf", &other.count, &other.sum, &other.max) != 3)
+		return false;
+
+	int c;
+	while ((c = fgetc(stream)) == ' ')
+	{
+		uint index;
+		ulong number;
+		if (fscanf(stream, "%u:%lu", &index, &number) != 2)
+			return false;
+		if (index >= other.counts.size())
+			other.counts.resize(index + 1, 0);
+		other.counts[index] += number;
+	}
+	if (c != '\n' && c != EOF)
+		return false;
+
+	merge(other);
+	return true;
+}
+
+void Histogram::snapshot(Snapshot &snapshot)
+{
+	snapshot.vector(counts);
+	snapshot.value(count);
+	snapshot.value(sum);
+	snapshot.value(max);
+}
+
+/* Histogram slot of a request type, -1 for types that are not timed */
+static int latency_type(enum event_type type)
+{
+	switch (type)
+	{
+		case READ:
+			return 0;
+		case WRITE:
+			return 1;
+		case TRIM:
+			return 2;
+		default:
+			return -1;
+	}
+}
+
 Stats::Stats()
 {
 	reset();
 }
 
+void Stats::record_latency(enum event_type type, uint streamID, double time)
+{
+	int slot = latency_type(type);
+	if (slot < 0)
+		return;
+
+	if ((streamID + 1) * LATENCY_TYPES > latency.size())
+		latency.resize((streamID + 1) * LATENCY_TYPES);
+	latency[streamID * LATENCY_TYPES + slot].record(time);
+}
+
+/* Adds the request latencies of another run, for instance another SSD of an
+ * array */
+void Stats::merge_latency(const Stats &other)
+{
+	if (other.latency.size() > latency.size())
+		latency.resize(other.latency.size());
+	for (uint i = 0; i < other.latency.size(); i++)
+		latency[i].merge(other.latency[i]);
+}
+
+/* Latency of a request type over all streams */
+Histogram Stats::get_latency(enum event_type type) const
+{
+	Histogram total;
+	int slot = latency_type(type);
+
+	for (uint i = slot; slot >= 0 && i < latency.size(); i += LATENCY_TYPES)
+		total.merge(latency[i]);
+	return total;
+}
+
 void Stats::reset()
 {
 	// FTL
@@ -70,10 +275,24 @@ void Stats::reset()
 	// Page based FTL's
 	numPageBlockToPageConversion = 0;
 
-	// Cache based FTL's numCacheHits = 0; numCacheFaults = 0; // Memory consumptions (Bytes) numMemoryTranslation = 0; numMemoryCache = 0;
+	// Cache based FTL's
+	numCacheHits = 0;
+	numCacheFaults = 0;
+
+	// Memory consumptions (Bytes)
+	numMemoryTranslation = 0;
+	numMemoryCache = 0;
 
 	numMemoryRead = 0;
 	numMemoryWrite = 0;
+
+	// Controller write buffer
+	numBufferReadHits = 0;
+	numBufferWriteHits = 0;
+	numBufferWriteBacks = 0;
+	numBufferFlushes = 0;
+
+	latency.clear();
 }
 
 void Stats::reset_statistics()
@@ -81,14 +300,54 @@ void Stats::reset_statistics()
 	reset();
 }
 
+void Stats::snapshot(Snapshot &snapshot)
+{
+	snapshot.value(numFTLRead);
+	snapshot.value(numFTLWrite);
+	snapshot.value(numFTLErase);
+	snapshot.value(numFTLWL);
+	snapshot.value(numFTLTrim);
+	snapshot.array(numCellAlloc, 2);
+	snapshot.array(numCellWrite, 2);
+	snapshot.array(numCellErase, 2);
+	snapshot.value(numGCRead);
+	snapshot.value(numGCWrite);
+	snapshot.value(numGCErase);
+	snapshot.value(GCElapsedTime);
+	snapshot.value(numWLRead);
+	snapshot.value(numWLWrite);
+	snapshot.value(numWLErase);
+	snapshot.value(numLogMergeSwitch);
+	snapshot.value(numLogMergePartial);
+	snapshot.value(numLogMergeFull);
+	snapshot.value(numPageBlockToPageConversion);
+	snapshot.value(numCacheHits);
+	snapshot.value(numCacheFaults);
+	snapshot.value(numMemoryTranslation);
+	snapshot.value(numMemoryCache);
+	snapshot.value(numMemoryRead);
+	snapshot.value(numMemoryWrite);
+	snapshot.value(numBufferReadHits);
+	snapshot.value(numBufferWriteHits);
+	snapshot.value(numBufferWriteBacks);
+	snapshot.value(numBufferFlushes);
+
+	ulong histograms = latency.size();
+	snapshot.value(histograms);
+	if (snapshot.is_loading())
+		latency.resize(histograms);
+	for (uint i = 0; i < histograms; i++)
+		latency[i].snapshot(snapshot);
+}
+
 void Stats::write_header(FILE *stream)
 {
-	fprintf(stream, "numFTLRead;numFTLWrite;numFTLErase;numFTLTrim;numGCRead;numGCWrite;numGCErase;numWLRead;numWLWrite;numWLErase;numLogMergeSwitch;numLogMergePartial;numLogMergeFull;numPageBlockToPageConversion;numCacheHits;numCacheFaults;numMemoryTranslation;numMemoryCache;numMemoryRead;numMemoryWrite\n");
+	fprintf(stream, "numFTLRead;numFTLWrite;numFTLErase;numFTLTrim;numGCRead;numGCWrite;numGCErase;numWLRead;numWLWrite;numWLErase;numLogMergeSwitch;numLogMergePartial;numLogMergeFull;numPageBlockToPageConversion;numCacheHits;numCacheFaults;numMemoryTranslation;numMemoryCache;numMemoryRead;numMemoryWrite;readP50;readP99;readP999;readP9999;writeP50;writeP99;writeP999;writeP9999;trimP50;trimP99;trimP999;trimP9999\n");
 }
 
 void Stats::write_statistics(FILE *stream)
 {
-	fprintf(stream, "%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;\n",
+	fprintf(stream, "%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;",
 			numFTLRead, numFTLWrite, numFTLErase, numFTLTrim,
 			numGCRead, numGCWrite, numGCErase,
 			numWLRead, numWLWrite, numWLErase,
@@ -99,6 +358,14 @@ void Stats::write_statistics(FILE *stream)
 			numMemoryCache,
 			numMemoryRead,numMemoryWrite);
 
+	const enum event_type types[LATENCY_TYPES] = {READ, WRITE, TRIM};
+	for (uint i = 0; i < LATENCY_TYPES; i++)
+	{
+		Histogram total = get_latency(types[i]);
+		fprintf(stream, "%f;%f;%f;%f;", total.percentile(50.0), total.percentile(99.0), total.percentile(99.9), total.percentile(99.99));
+	}
+	fprintf(stream, "\n");
+
 	//print_statistics();
 }
 
@@ -124,11 +391,80 @@ void Stats::print_statistics()
 	printf("WL  Reads: %li\t Writes: %li\t Erases: %li\n", numWLRead, numWLWrite, numWLErase);
 	printf("Log FTL Switch: %li Partial: %li Full: %li\n", numLogMergeSwitch, numLogMergePartial, numLogMergeFull);
 	printf("Page FTL Convertions: %li\n", numPageBlockToPageConversion);
-	printf("Cache Hits: %li Faults: %li Hit Ratio: %f\n", numCacheHits, numCacheFaults, (double)numCacheHits/(double)(numCacheHits+numCacheFaults));
+	printf("Cache Hits: %li Faults: %li Hit Ratio: %f\n", numCacheHits, numCacheFaults, numCacheHits + numCacheFaults > 0 ? (double)numCacheHits/(double)(numCacheHits+numCacheFaults) : 0.0);
 	printf("Memory Consumption:\n");
 	printf("Tranlation: %li Cache: %li\n", numMemoryTranslation, numMemoryCache);
 	printf("Reads: %li \t Writes: %li\n", numMemoryRead, numMemoryWrite);
+	printf("Write Buffer Read Hits: %li Write Hits: %li Write Backs: %li Flushes: %li\n", numBufferReadHits, numBufferWriteHits, numBufferWriteBacks, numBufferFlushes);
 	printf("Overheads:\n\tErase: MLC: %li\t SLC: %li\t GC Elapsed: %f\n", numCellErase[MLC], numCellErase[SLC], GCElapsedTime); // Yoohyuk Lim
 	printf("\tWrite: MLC: %li\t SLC: %li\t\n", numCellWrite[MLC], numCellWrite[SLC]); // Yoohyuk Lim
+	print_latency();
 	printf("-----------\n");
 }
+
+void Stats::print_latency()
+{
+	const enum event_type types[LATENCY_TYPES] = {READ, WRITE, TRIM};
+	const char *names[LATENCY_TYPES] = {"Read", "Write", "Trim"};
+	printf("Latency:\tRequests\tMean\t\tp50\t\tp99\t\tp99.9\t\tp99.99\t\tMax\n");
+	for (uint i = 0; i < LATENCY_TYPES; i++)
+	{
+		Histogram total = get_latency(types[i]);
+		printf("%s:\t\t%lu\t\t%f\t%f\t%f\t%f\t%f\t%f\n", names[i], total.get_count(), total.get_mean(),
+			total.percentile(50.0), total.percentile(99.0), total.percentile(99.9), total.percentile(99.99), total.get_max());
+	}
+
+	/* per stream only when more than one stream saw requests */
+	uint streams = 0;
+	for (uint stream = 0; stream * LATENCY_TYPES < latency.size(); stream++)
+	{
+		for (uint i = 0; i < LATENCY_TYPES; i++)
+		{
+			if (latency[stream * LATENCY_TYPES + i].get_count() > 0)
+			{
+				streams++;
+				break;
+			}
+		}
+	}
+	for (uint i = 0; streams > 1 && i < latency.size(); i++)
+	{
+		const Histogram &histogram = latency[i];
+		if (histogram.get_count() == 0)
+			continue;
+		printf("Stream %u %s:\t%lu\t\t%f\t%f\t%f\t%f\t%f\t%f\n", i / LATENCY_TYPES, names[i % LATENCY_TYPES], histogram.get_count(), histogram.get_mean(),
+			histogram.percentile(50.0), histogram.percentile(99.0), histogram.percentile(99.9), histogram.percentile(99.99), histogram.get_max());
+	}
+}
+
+/* One line per non-empty histogram: stream, request type slot and the
+ * histogram as written by Histogram::write */
+void Stats::write_latency(FILE *stream)
+{
+	for (uint i = 0; i < latency.size(); i++)
+	{
+		if (latency[i].get_count() == 0)
+			continue;
+		fprintf(stream, "%u %u ", i / LATENCY_TYPES, i % LATENCY_TYPES);
+		latency[i].write(stream);
+	}
+}
+
+/* Reads the lines written by write_latency and merges them into the
+ * histograms, false if the file is not a latency file */
+bool Stats::read_latency(FILE *stream)
+{
+	uint streamID, slot;
+	int fields;
+
+	while ((fields = fscanf(stream, "%u %u", &streamID, &slot)) == 2)
+	{
+		if (slot >= LATENCY_TYPES)
+			return false;
+		if ((streamID + 1) * LATENCY_TYPES > latency.size())
+			latency.resize((streamID + 1) * LATENCY_TYPES);
+		if (!latency[streamID * LATENCY_TYPES + slot].read(stream))
+			return false;
+	}
+	return fields == EOF;
+}
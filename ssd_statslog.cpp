@@ -0,0 +1,205 @@
+/* ssd_statslog.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* StatsLog class
+ *
+ * Writes the interval statistics of an Ssd.  The log follows the arrival
+ * times of the requests: before a request is serviced every interval that
+ * ended by its arrival is written, so the counters of the controller still
+ * hold the state at the end of those intervals.  Intervals without requests
+ * are written too, idle periods show up as rows of zeros.  The first
+ * interval starts at the interval boundary before the first request and the
+ * last, partial interval is written when the log is closed.
+ */
+
+#include <new>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* request types counted per interval */
+#define STATS_LOG_TYPES 3
+
+StatsLog::StatsLog(Ssd &ssd):
+	ssd(ssd),
+	stream(NULL),
+	json(false),
+	interval(0.0),
+	interval_start(0.0),
+	started(false),
+	latency(),
+	flash_writes(0),
+	gc_time(0.0),
+	cache_hits(0),
+	cache_faults(0)
+{
+	clear_interval();
+}
+
+StatsLog::~StatsLog(void)
+{
+	close();
+}
+
+void StatsLog::open(const char *path, double interval)
+{
+	if (interval <= 0.0)
+	{
+		fprintf(stderr, "StatsLog error: %s: interval must be positive\n", __func__);
+		exit(FILE_ERR);
+	}
+
+	close();
+	if ((stream = fopen(path, "w")) == NULL)
+	{
+		fprintf(stderr, "StatsLog error: %s: could not create statistics log %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	const char *extension = strrchr(path, '.');
+	json = extension != NULL && (!strcmp(extension, ".json") || !strcmp(extension, ".jsonl"));
+	this->interval = interval;
+	started = false;
+	clear_interval();
+	rebase();
+
+	if (!json)
+		fprintf(stream, "time,reads,writes,trims,iops,read_mbps,write_mbps,mean_latency,p99_latency,gc_time,write_amplification,free_blocks,cache_hit_ratio\n");
+}
+
+/* Writes the interval in progress and closes the log */
+void StatsLog::close(void)
+{
+	if (stream == NULL)
+		return;
+
+	if (started)
+		write_interval();
+	fclose(stream);
+	stream = NULL;
+}
+
+bool StatsLog::is_open(void) const
+{
+	return stream != NULL;
+}
+
+/* Writes every interval that ended by the given time */
+void StatsLog::advance(double time)
+{
+	if (stream == NULL)
+		return;
+
+	if (!started)
+	{
+		interval_start = floor(time / interval) * interval;
+		started = true;
+		return;
+	}
+
+	while (time >= interval_start + interval)
+	{
+		write_interval();
+		interval_start += interval;
+	}
+}
+
+void StatsLog::record(const Event &event)
+{
+	if (stream == NULL)
+		return;
+
+	uint type;
+	switch (event.get_event_type())
+	{
+		case READ:
+			type = 0;
+			break;
+		case WRITE:
+			type = 1;
+			break;
+		case TRIM:
+			type = 2;
+			break;
+		default:
+			return;
+	}
+
+	requests[type]++;
+	pages[type] += event.get_size();
+	latency.record(event.get_time_taken());
+}
+
+/* Takes the current counters as the start of the interval, for instance
+ * after the statistics have been reset */
+void StatsLog::rebase(void)
+{
+	const Stats &stats = ssd.controller.stats;
+
+	flash_writes = stats.numFTLWrite;
+	gc_time = stats.GCElapsedTime;
+	cache_hits = stats.numCacheHits;
+	cache_faults = stats.numCacheFaults;
+}
+
+void StatsLog::write_interval(void)
+{
+	const Stats &stats = ssd.controller.stats;
+	double seconds = interval / 1000000.0;
+	double megabytes = PAGE_SIZE / 1000000.0;
+
+	ulong total = requests[0] + requests[1] + requests[2];
+	long writes = stats.numFTLWrite - flash_writes;
+	long hits = stats.numCacheHits - cache_hits;
+	long faults = stats.numCacheFaults - cache_faults;
+
+	double iops = total / seconds;
+	double read_mbps = pages[0] * megabytes / seconds;
+	double write_mbps = pages[1] * megabytes / seconds;
+	double amplification = pages[1] > 0 ? (double) writes / pages[1] : 0.0;
+	double hit_ratio = hits + faults > 0 ? (double) hits / (hits + faults) : 0.0;
+	int free_blocks = ssd.get_block_manager().get_num_free_blocks();
+
+	if (json)
+		fprintf(stream, "{\"time\":%f,\"reads\":%lu,\"writes\":%lu,\"trims\":%lu,\"iops\":%f,\"read_mbps\":%f,\"write_mbps\":%f,"
+			"\"mean_latency\":%f,\"p99_latency\":%f,\"gc_time\":%f,\"write_amplification\":%f,\"free_blocks\":%i,\"cache_hit_ratio\":%f}\n",
+			interval_start + interval, requests[0], requests[1], requests[2], iops, read_mbps, write_mbps,
+			latency.get_mean(), latency.percentile(99.0), stats.GCElapsedTime - gc_time, amplification, free_blocks, hit_ratio);
+	else
+		fprintf(stream, "%f,%lu,%lu,%lu,%f,%f,%f,%f,%f,%f,%f,%i,%f\n",
+			interval_start + interval, requests[0], requests[1], requests[2], iops, read_mbps, write_mbps,
+			latency.get_mean(), latency.percentile(99.0), stats.GCElapsedTime - gc_time, amplification, free_blocks, hit_ratio);
+
+	/* let a running tail -f see the interval */
+	fflush(stream);
+
+	clear_interval();
+	rebase();
+}
+
+void StatsLog::clear_interval(void)
+{
+	for (uint i = 0; i < STATS_LOG_TYPES; i++)
+	{
+		requests[i] = 0;
+		pages[i] = 0;
+	}
+	latency.reset();
+}
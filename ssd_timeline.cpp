@@ -0,0 +1,445 @@
+/* ssd_timeline.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Timeline class
+ *
+ * Busy timeline of a shared resource such as a bus channel.  The timeline
+ * holds the reservations (lock and unlock times) that have not expired yet and
+ * finds the earliest place at or after its start time a new reservation of a
+ * given duration fits:
+ * 	at the start time if that is free until the next reservation,
+ * 	else in the first later gap between two reservations that is long enough,
+ * 	else after the last reservation.
+ * Reservations that finish at or before the current simulation time are
+ * expired first.  The current time is the latest arrival the Ssd serviced,
+ * not the start time of the new reservation: garbage collection and other
+ * operations a request issues later start well ahead of the next arrivals,
+ * which must still find the reservations those arrivals overlap.  A new
+ * reservation never starts before the end of an expired one, so the
+ * reservations of a timeline never overlap.
+ *
+ * Reservations never overlap, so ordering them by lock time also orders them
+ * by unlock time.  They are kept in a treap ordered by lock time where each
+ * node stores the gap to its successor and the largest gap in its subtree.
+ * Expiring reservations removes a prefix of the treap and finding the first
+ * gap after the start time that is long enough is a single descent, so a lock
+ * costs O(log n) instead of a sort of the whole table.
+ */
+
+#include <new>
+#include <limits>
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* number of reservations allocated together when the free list runs dry */
+#define TIMELINE_SLAB_SIZE 256
+
+/* gap of the last reservation, which has no successor */
+static const double NO_GAP = -std::numeric_limits<double>::infinity();
+
+Timeline::Timeline(void):
+	root(NULL),
+	free_nodes(NULL),
+	slabs(),
+	entries(0),
+	seed(0x9e3779b9u),
+	ready_at(-1),
+	expired_at(0.0)
+{
+	return;
+}
+
+Timeline::~Timeline(void)
+{
+	for (uint i = 0; i < slabs.size(); i++)
+		free(slabs[i]);
+	return;
+}
+
+/* reserve the timeline for duration, no earlier than start_time
+ * now is the current simulation time, which must not decrease between locks
+ * returns the time the reservation starts */
+double Timeline::lock(double now, double start_time, double duration)
+{
+	assert(start_time >= 0.0);
+	assert(duration >= 0.0);
+
+	/* free up reservations that have finished */
+	expire(now);
+
+	/* the expired reservations held the timeline until expired_at */
+	if (start_time < expired_at)
+		start_time = expired_at;
+
+	/* the reservation locked last at or before start_time may still hold
+	 * the timeline at start_time */
+	double begin = start_time;
+	Node *prev = NULL;
+	Node *next = NULL;
+	for (Node *node = root; node != NULL; )
+	{
+		if (node->lock_time <= start_time)
+		{
+			prev = node;
+			node = node->right;
+		}
+		else
+		{
+			next = node;
+			node = node->left;
+		}
+	}
+	if (prev != NULL && prev->unlock_time > begin)
+		begin = prev->unlock_time;
+
+	double sched_time;
+	Node *gap;
+
+	/* schedule at start_time or right after the reservation holding it */
+	if (next == NULL || next->lock_time - begin >= duration)
+		sched_time = begin;
+
+	/* schedule in the first later gap that is long enough */
+	else if ((gap = find_gap_after(root, start_time, duration)) != NULL)
+		sched_time = gap->unlock_time;
+
+	/* schedule after all reservations */
+	else
+	{
+		Node *last = root;
+		while (last->right != NULL)
+			last = last->right;
+		sched_time = last->unlock_time;
+	}
+
+	insert(sched_time, sched_time + duration);
+
+	if (sched_time + duration > ready_at)
+		ready_at = sched_time + duration;
+
+	return sched_time;
+}
+
+/* latest unlock time of any reservation made so far, -1 if none */
+double Timeline::ready_time(void) const
+{
+	return ready_at;
+}
+
+/* number of reservations that have not expired */
+ssd::uint Timeline::size(void) const
+{
+	return entries;
+}
+
+/* save the reservations as lock and unlock times in order, or replace the
+ * reservations with saved ones; the treap is rebuilt by inserting them again
+ * and the seed restored after, so later locks behave as on the saved one */
+void Timeline::snapshot(Snapshot &snapshot)
+{
+	std::vector<double> times;
+
+	if (!snapshot.is_loading())
+		collect(root, times);
+	snapshot.vector(times);
+	if (snapshot.is_loading())
+	{
+		release(root);
+		root = NULL;
+		for (uint i = 0; i + 1 < times.size(); i += 2)
+			insert(times[i], times[i + 1]);
+	}
+	snapshot.value(seed);
+	snapshot.value(ready_at);
+	snapshot.value(expired_at);
+	return;
+}
+
+/* remove all reservations with an unlock time at or before now
+ * these form a prefix of the timeline */
+void Timeline::expire(double now)
+{
+	if (root == NULL)
+		return;
+
+	/* nothing to do unless the first reservation has finished */
+	Node *first = root;
+	while (first->left != NULL)
+		first = first->left;
+	if (first->unlock_time > now)
+		return;
+
+	Node *expired;
+	split_unlocked(root, now, expired, root);
+
+	Node *last = expired;
+	while (last->right != NULL)
+		last = last->right;
+	if (last->unlock_time > expired_at)
+		expired_at = last->unlock_time;
+	release(expired);
+	return;
+}
+
+/* append the lock and unlock times of the subtree in order */
+void Timeline::collect(const Node *node, std::vector<double> &times)
+{
+	while (node != NULL)
+	{
+		collect(node->left, times);
+		times.push_back(node->lock_time);
+		times.push_back(node->unlock_time);
+		node = node->right;
+	}
+	return;
+}
+
+/* leftmost reservation whose gap to its successor is at least duration
+ * the subtree must contain such a gap */
+Timeline::Node *Timeline::find_gap(Node *node, double duration)
+{
+	for (;;)
+	{
+		assert(node != NULL && node->max_gap >= duration);
+		if (node->left != NULL && node->left->max_gap >= duration)
+			node = node->left;
+		else if (node->gap >= duration)
+			return node;
+		else
+			node = node->right;
+	}
+}
+
+/* leftmost reservation locked after start_time whose gap to its successor is
+ * at least duration, NULL if there is none */
+Timeline::Node *Timeline::find_gap_after(Node *node, double start_time, double duration)
+{
+	while (node != NULL && node->max_gap >= duration)
+	{
+		/* the reservation and its left subtree are locked at or before
+		 * start_time */
+		if (node->lock_time <= start_time)
+		{
+			node = node->right;
+			continue;
+		}
+
+		Node *found = find_gap_after(node->left, start_time, duration);
+		if (found != NULL)
+			return found;
+		if (node->gap >= duration)
+			return node;
+
+		/* the right subtree is locked after start_time */
+		if (node->right != NULL && node->right->max_gap >= duration)
+			return find_gap(node->right, duration);
+		return NULL;
+	}
+	return NULL;
+}
+
+/* add a reservation after all reservations with the same or an earlier lock
+ * time and refresh the gaps of its neighbours
+ * the reservation must not overlap another, so no gap is negative */
+void Timeline::insert(double lock_time, double unlock_time)
+{
+	Node *node = alloc();
+	node->lock_time = lock_time;
+	node->unlock_time = unlock_time;
+	node->priority = next_priority();
+	node->left = NULL;
+	node->right = NULL;
+
+	Node *last = root;
+	while (last != NULL && last->right != NULL)
+		last = last->right;
+
+	/* most reservations go after all others */
+	if (last == NULL || last->lock_time <= lock_time)
+	{
+		node->gap = NO_GAP;
+		update(node);
+		if (root != NULL)
+			set_last_gap(root, lock_time);
+		root = merge(root, node);
+		entries++;
+		return;
+	}
+
+	Node *before;
+	Node *after;
+	split_locked(root, lock_time, before, after);
+
+	if (after != NULL)
+	{
+		Node *succ = after;
+		while (succ->left != NULL)
+			succ = succ->left;
+		node->gap = succ->lock_time - unlock_time;
+	}
+	else
+		node->gap = NO_GAP;
+	assert(node->gap == NO_GAP || node->gap >= 0.0);
+	update(node);
+
+	if (before != NULL)
+		set_last_gap(before, lock_time);
+
+	root = merge(merge(before, node), after);
+	entries++;
+	return;
+}
+
+/* split into reservations with lock time <= lock_time and the rest */
+void Timeline::split_locked(Node *node, double lock_time, Node *&left, Node *&right)
+{
+	if (node == NULL)
+	{
+		left = right = NULL;
+		return;
+	}
+	if (node->lock_time <= lock_time)
+	{
+		split_locked(node->right, lock_time, node->right, right);
+		left = node;
+	}
+	else
+	{
+		split_locked(node->left, lock_time, left, node->left);
+		right = node;
+	}
+	update(node);
+	return;
+}
+
+/* split into reservations with unlock time <= unlock_time and the rest */
+void Timeline::split_unlocked(Node *node, double unlock_time, Node *&left, Node *&right)
+{
+	if (node == NULL)
+	{
+		left = right = NULL;
+		return;
+	}
+	if (node->unlock_time <= unlock_time)
+	{
+		split_unlocked(node->right, unlock_time, node->right, right);
+		left = node;
+	}
+	else
+	{
+		split_unlocked(node->left, unlock_time, left, node->left);
+		right = node;
+	}
+	update(node);
+	return;
+}
+
+/* join two treaps where every reservation in left precedes those in right */
+Timeline::Node *Timeline::merge(Node *left, Node *right)
+{
+	if (left == NULL)
+		return right;
+	if (right == NULL)
+		return left;
+	if (left->priority > right->priority)
+	{
+		left->right = merge(left->right, right);
+		update(left);
+		return left;
+	}
+	right->left = merge(left, right->left);
+	update(right);
+	return right;
+}
+
+/* set the gap of the last reservation in the subtree to the reservation that
+ * now follows it at lock_time */
+void Timeline::set_last_gap(Node *node, double lock_time)
+{
+	if (node->right != NULL)
+		set_last_gap(node->right, lock_time);
+	else
+	{
+		node->gap = lock_time - node->unlock_time;
+		assert(node->gap >= 0.0);
+	}
+	update(node);
+	return;
+}
+
+void Timeline::update(Node *node)
+{
+	double max_gap = node->gap;
+	if (node->left != NULL && node->left->max_gap > max_gap)
+		max_gap = node->left->max_gap;
+	if (node->right != NULL && node->right->max_gap > max_gap)
+		max_gap = node->right->max_gap;
+	node->max_gap = max_gap;
+	return;
+}
+
+/* xorshift, only needs to keep the treap balanced */
+ssd::uint Timeline::next_priority(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+Timeline::Node *Timeline::alloc(void)
+{
+	if (free_nodes == NULL)
+	{
+		Node *slab = (Node *) malloc(TIMELINE_SLAB_SIZE * sizeof(Node));
+		if (slab == NULL)
+		{
+			fprintf(stderr, "Timeline error: %s: could not allocate reservations\n", __func__);
+			exit(MEM_ERR);
+		}
+		slabs.push_back(slab);
+
+		for (uint i = 0; i < TIMELINE_SLAB_SIZE; i++)
+		{
+			slab[i].right = free_nodes;
+			free_nodes = &slab[i];
+		}
+	}
+
+	Node *node = free_nodes;
+	free_nodes = node->right;
+	return node;
+}
+
+/* return a whole subtree to the free list */
+void Timeline::release(Node *node)
+{
+	while (node != NULL)
+	{
+		if (node->left != NULL)
+			release(node->left);
+		Node *right = node->right;
+		node->right = free_nodes;
+		free_nodes = node;
+		entries--;
+		node = right;
+	}
+	return;
+}
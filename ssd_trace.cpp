@@ -0,0 +1,746 @@
+/* ssd_trace.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* TraceReader class
+ *
+ * Reads block traces without copying them through stdio.  The file is mapped
+ * and cut into chunks of TRACE_CHUNK_SIZE bytes, each moved forward to the
+ * start of the next line, so a chunk can be parsed without looking at its
+ * neighbours.  Workers claim chunks in order and parse them into the ring
+ * slot of the chunk, the reader drains the slots in chunk order and hands
+ * each slot back by advancing its sequence number.
+ *
+ * Fields are parsed by hand: the mapped trace is not nul terminated, and
+ * sscanf and strtod dominate the parsing time of large traces.
+ *
+ * Binary traces need no parsing at all.  Their records are read straight
+ * from the mapping by the reading thread and no workers are started.
+ */
+
+#include <new>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+const char TraceReader::BINARY_MAGIC[8] = {'F', 'S', 'I', 'M', 'T', 'R', 'A', 'C'};
+const uint32_t TraceReader::BINARY_VERSION;
+
+/* bytes of trace parsed by a worker at a time */
+#define TRACE_CHUNK_SIZE (4 << 20)
+
+/* chunk slots per worker thread */
+#define TRACE_SLOTS_PER_THREAD 4
+
+/* lines looked at to detect the format of a trace */
+#define TRACE_DETECT_LINES 64
+
+/* bytes per sector of SPC and blkparse traces */
+#define TRACE_SECTOR_SIZE 512
+
+/* largest decimal exponent applied, beyond it every double is 0 or infinite */
+#define TRACE_MAX_EXPONENT 1000
+
+namespace {
+
+inline bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+inline const char *skip_space(const char *p, const char *end)
+{
+	while (p < end && is_space(*p))
+		p++;
+	return p;
+}
+
+/* moves past the next separator, returns end if there is none */
+inline const char *skip_field(const char *p, const char *end, char separator)
+{
+	while (p < end && *p != separator)
+		p++;
+	return p < end ? p + 1 : end;
+}
+
+/* unsigned decimal number, false if there are no digits */
+bool parse_ulong(const char *&p, const char *end, ulong &value)
+{
+	p = skip_space(p, end);
+	if (p == end || !is_digit(*p))
+		return false;
+
+	value = 0;
+	while (p < end && is_digit(*p))
+		value = value * 10 + (*p++ - '0');
+	return true;
+}
+
+/* unsigned decimal fraction with an optional exponent */
+bool parse_double(const char *&p, const char *end, double &value)
+{
+	p = skip_space(p, end);
+	if (p == end || (!is_digit(*p) && *p != '.'))
+		return false;
+
+	/* up to 19 digits are gathered exactly and the exponent is folded
+	 * into scale, so a single power of ten is applied. Mantissas up to
+	 * 2^53 with scales up to 22 round like strtod, beyond that the
+	 * result may be an ulp off and subnormals come out as zero */
+	ulong mantissa = 0;
+	uint digits = 0;
+	int scale = 0;
+	while (p < end && is_digit(*p))
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa > 0;
+		}
+		else
+			scale++;
+		p++;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && is_digit(*p); p++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa > 0;
+				scale--;
+			}
+		}
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char *q = p + 1;
+		bool negative = q < end && *q == '-';
+		if (q < end && (*q == '-' || *q == '+'))
+			q++;
+		ulong exponent;
+		if (parse_ulong(q, end, exponent))
+		{
+			if (exponent > TRACE_MAX_EXPONENT)
+				exponent = TRACE_MAX_EXPONENT;
+			scale += negative ? -(int) exponent : (int) exponent;
+			p = q;
+		}
+	}
+
+	double result = mantissa;
+	if (scale < 0)
+		result /= pow(10.0, -scale);
+	else if (scale > 0)
+		result *= pow(10.0, scale);
+
+	value = result;
+	return true;
+}
+
+/* next whitespace separated token of a line */
+inline bool next_token(const char *&p, const char *end, const char *&token, const char *&token_end)
+{
+	p = skip_space(p, end);
+	if (p == end)
+		return false;
+	token = p;
+	while (p < end && !is_space(*p))
+		p++;
+	token_end = p;
+	return true;
+}
+
+}
+
+TraceReader::TraceReader(const char *path, enum trace_format format, uint threads):
+	fd(-1),
+	data(NULL),
+	size(0),
+	format(format),
+	time_base(0),
+	chunks(0),
+	ring_size(0),
+	ring(NULL),
+	next_chunk(0),
+	stopping(false),
+	workers(),
+	binary_records(NULL),
+	binary_count(0),
+	binary_time(0),
+	current(0),
+	index(0),
+	started(false),
+	first_time(0.0),
+	skipped(0)
+{
+	if ((fd = open(path, O_RDONLY)) == -1)
+	{
+		fprintf(stderr, "TraceReader error: %s: could not open trace file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == -1)
+	{
+		fprintf(stderr, "TraceReader error: %s: could not stat trace file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+	size = info.st_size;
+
+	if (size > 0)
+	{
+		void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+		{
+			fprintf(stderr, "TraceReader error: %s: could not map trace file %s\n", __func__, path);
+			exit(MEM_ERR);
+		}
+		(void) madvise(map, size, MADV_SEQUENTIAL);
+		data = (const char *) map;
+	}
+
+	if (this->format == TRACE_AUTO && size > 0)
+		this->format = detect_format(data, size);
+	if (this->format == TRACE_MSR)
+		time_base = detect_time_base();
+	if (this->format == TRACE_BINARY)
+	{
+		open_binary(path);
+		return;
+	}
+
+	chunks = (size + TRACE_CHUNK_SIZE - 1) / TRACE_CHUNK_SIZE;
+
+	/* the reading thread simulates, the others parse */
+	if (threads == 0)
+		threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	threads = std::max(1ul, std::min((ulong) threads, chunks));
+
+	ring_size = threads * TRACE_SLOTS_PER_THREAD;
+	ring = new (std::nothrow) Slot[ring_size];
+	if (ring == NULL)
+	{
+		fprintf(stderr, "TraceReader error: %s: constructing chunk ring failed\n", __func__);
+		exit(MEM_ERR);
+	}
+	for (uint i = 0; i < ring_size; i++)
+	{
+		ring[i].sequence.store(2 * (ulong) i);
+		ring[i].skipped = 0;
+	}
+
+	for (uint i = 0; i < threads && chunks > 0; i++)
+		workers.push_back(std::thread(&TraceReader::worker_main, this));
+}
+
+TraceReader::~TraceReader(void)
+{
+	stopping.store(true);
+	for (uint i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	delete[] ring;
+	if (data != NULL)
+		(void) munmap((void *) data, size);
+	if (fd != -1)
+		(void) close(fd);
+}
+
+/* Fetch the next request of the trace, false at the end of the trace */
+bool TraceReader::next(TraceRecord &record)
+{
+	if (format == TRACE_BINARY)
+	{
+		if (index == binary_count)
+			return false;
+
+		const TraceFileRecord &entry = binary_records[index++];
+		if (entry.type != READ && entry.type != WRITE && entry.type != TRIM)
+		{
+			fprintf(stderr, "TraceReader error: %s: record %lu of the binary trace has unknown request type %u\n", __func__, index - 1, entry.type);
+			exit(FILE_ERR);
+		}
+		binary_time += entry.time_delta;
+		record.type = (enum event_type) entry.type;
+		record.logical_address = entry.logical_address;
+		record.size = entry.size;
+		record.arrive_time = binary_time / 1000000.0;
+		record.streamID = entry.streamID;
+		return true;
+	}
+
+	while (current < chunks)
+	{
+		Slot &slot = ring[current % ring_size];
+		while (slot.sequence.load(std::memory_order_acquire) != 2 * current + 1)
+			std::this_thread::yield();
+
+		if (index < slot.records.size())
+		{
+			record = slot.records[index++];
+			if (format != TRACE_UFLIP)
+			{
+				if (!started)
+				{
+					first_time = record.arrive_time;
+					started = true;
+				}
+				record.arrive_time = std::max(0.0, record.arrive_time - first_time);
+			}
+			return true;
+		}
+
+		/* hand the slot back for the chunk ring_size chunks ahead */
+		skipped += slot.skipped;
+		slot.sequence.store(2 * (current + ring_size), std::memory_order_release);
+		current++;
+		index = 0;
+	}
+	return false;
+}
+
+enum trace_format TraceReader::get_format(void) const
+{
+	return format;
+}
+
+/* Size of the trace file in bytes */
+ssd::ulong TraceReader::get_size(void) const
+{
+	return size;
+}
+
+/* Lines of the chunks read so far that held no request */
+ssd::ulong TraceReader::get_skipped_lines(void) const
+{
+	return skipped;
+}
+
+/* Format named on a command line */
+enum trace_format TraceReader::parse_format(const char *name)
+{
+	if (!strcmp(name, "auto"))
+		return TRACE_AUTO;
+	else if (!strcmp(name, "uflip"))
+		return TRACE_UFLIP;
+	else if (!strcmp(name, "msr"))
+		return TRACE_MSR;
+	else if (!strcmp(name, "spc"))
+		return TRACE_SPC;
+	else if (!strcmp(name, "blkparse"))
+		return TRACE_BLKPARSE;
+	else if (!strcmp(name, "binary"))
+		return TRACE_BINARY;
+
+	fprintf(stderr, "TraceReader error: %s: unknown trace format %s, use auto, uflip, msr, spc, blkparse or binary\n", __func__, name);
+	exit(FILE_ERR);
+}
+
+/* The first format one of the first lines of the trace parses as.  Formats
+ * are tried from the most to the least specific. */
+enum trace_format TraceReader::detect_format(const char *data, ulong size)
+{
+	static const enum trace_format formats[] = {TRACE_MSR, TRACE_SPC, TRACE_UFLIP, TRACE_BLKPARSE};
+	const char *end = data + size;
+	const char *line = data;
+
+	if (size >= sizeof(TraceFileHeader) && !memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)))
+		return TRACE_BINARY;
+
+	for (uint i = 0; i < TRACE_DETECT_LINES && line < end; i++)
+	{
+		const char *line_end = (const char *) memchr(line, '\n', end - line);
+		if (line_end == NULL)
+			line_end = end;
+
+		for (uint f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+		{
+			TraceRecord record;
+			if (parse_line(formats[f], 0, line, line_end, record))
+				return formats[f];
+		}
+		line = line_end + 1;
+	}
+
+	fprintf(stderr, "TraceReader error: %s: could not detect the trace format\n", __func__);
+	exit(FILE_ERR);
+}
+
+/* Checks the header of a binary trace.  A truncated trace is read up to its
+ * last whole record. */
+void TraceReader::open_binary(const char *path)
+{
+	const TraceFileHeader *header = (const TraceFileHeader *) data;
+
+	if (size < sizeof(TraceFileHeader) || memcmp(header->magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)))
+	{
+		fprintf(stderr, "TraceReader error: %s: %s is not a binary trace\n", __func__, path);
+		exit(FILE_ERR);
+	}
+	if (header->version != BINARY_VERSION || header->record_size != sizeof(TraceFileRecord))
+	{
+		fprintf(stderr, "TraceReader error: %s: %s has binary trace version %u with %u byte records, expected version %u with %u byte records\n",
+			__func__, path, header->version, header->record_size, BINARY_VERSION, (uint) sizeof(TraceFileRecord));
+		exit(FILE_ERR);
+	}
+
+	binary_records = (const TraceFileRecord *) (data + sizeof(TraceFileHeader));
+	binary_count = std::min((ulong) header->records, (size - sizeof(TraceFileHeader)) / sizeof(TraceFileRecord));
+}
+
+/* Timestamp of the first request of a MSR trace */
+ssd::ulong TraceReader::detect_time_base(void) const
+{
+	const char *end = data + size;
+	const char *line = data;
+
+	while (line < end)
+	{
+		const char *line_end = (const char *) memchr(line, '\n', end - line);
+		if (line_end == NULL)
+			line_end = end;
+
+		TraceRecord record;
+		ulong timestamp;
+		const char *p = line;
+		if (parse_msr(0, line, line_end, record) && parse_ulong(p, line_end, timestamp))
+			return timestamp;
+		line = line_end + 1;
+	}
+	return 0;
+}
+
+bool TraceReader::parse_line(enum trace_format format, ulong time_base, const char *line, const char *end, TraceRecord &record)
+{
+	record.streamID = STREAMID_DEFAULT;
+	switch (format)
+	{
+		case TRACE_UFLIP:
+			return parse_uflip(line, end, record);
+		case TRACE_MSR:
+			return parse_msr(time_base, line, end, record);
+		case TRACE_SPC:
+			return parse_spc(line, end, record);
+		case TRACE_BLKPARSE:
+			return parse_blkparse(line, end, record);
+		default:
+			return false;
+	}
+}
+
+/* "S; W; 1024; 0; 4; 0.25" */
+bool TraceReader::parse_uflip(const char *line, const char *end, TraceRecord &record)
+{
+	const char *p = skip_field(line, end, ';');
+	p = skip_space(p, end);
+	if (p == end)
+		return false;
+	if (*p == 'R')
+		record.type = READ;
+	else if (*p == 'W')
+		record.type = WRITE;
+	else
+		return false;
+
+	ulong address, query_time, pages;
+	double arrive_time;
+	p = skip_field(p, end, ';');
+	if (!parse_ulong(p, end, address))
+		return false;
+	p = skip_field(p, end, ';');
+	if (!parse_ulong(p, end, query_time))
+		return false;
+	p = skip_field(p, end, ';');
+	if (!parse_ulong(p, end, pages) || pages == 0)
+		return false;
+	p = skip_field(p, end, ';');
+	if (!parse_double(p, end, arrive_time))
+		return false;
+
+	record.logical_address = address;
+	record.size = pages;
+	record.arrive_time = arrive_time;
+	return true;
+}
+
+/* "128166372003061629,hm,1,Read,383897088,32768,9432"
+ * the timestamp counts 100 ns ticks from time_base */
+bool TraceReader::parse_msr(ulong time_base, const char *line, const char *end, TraceRecord &record)
+{
+	const char *p = line;
+	ulong timestamp, disk, offset, length;
+
+	if (!parse_ulong(p, end, timestamp) || p == end || *p != ',')
+		return false;
+	p = skip_field(p, end, ',');
+	p = skip_field(p, end, ',');
+	if (!parse_ulong(p, end, disk) || p == end || *p != ',')
+		return false;
+	p = skip_space(p + 1, end);
+	if (end - p >= 4 && !strncmp(p, "Read", 4))
+		record.type = READ;
+	else if (end - p >= 5 && !strncmp(p, "Write", 5))
+		record.type = WRITE;
+	else
+		return false;
+	p = skip_field(p, end, ',');
+	if (!parse_ulong(p, end, offset))
+		return false;
+	p = skip_field(p, end, ',');
+	if (!parse_ulong(p, end, length) || length == 0)
+		return false;
+
+	set_bytes(record, offset, length);
+	record.arrive_time = timestamp >= time_base ? (timestamp - time_base) / 10.0 : -((time_base - timestamp) / 10.0);
+	return true;
+}
+
+/* "0,20941264,8192,W,0.551706"
+ * the address counts sectors, the size bytes and the timestamp seconds */
+bool TraceReader::parse_spc(const char *line, const char *end, TraceRecord &record)
+{
+	const char *p = line;
+	ulong asu, lba, length;
+	double timestamp;
+
+	if (!parse_ulong(p, end, asu) || p == end || *p != ',')
+		return false;
+	p++;
+	if (!parse_ulong(p, end, lba) || p == end || *p != ',')
+		return false;
+	p++;
+	if (!parse_ulong(p, end, length) || length == 0 || p == end || *p != ',')
+		return false;
+	p = skip_space(p + 1, end);
+	if (p == end)
+		return false;
+	if (*p == 'r' || *p == 'R')
+		record.type = READ;
+	else if (*p == 'w' || *p == 'W')
+		record.type = WRITE;
+	else
+		return false;
+	p = skip_field(p, end, ',');
+	if (!parse_double(p, end, timestamp))
+		return false;
+
+	set_bytes(record, lba * TRACE_SECTOR_SIZE, length);
+	record.arrive_time = timestamp * 1000000.0;
+	return true;
+}
+
+/* "  8,0    3        1     0.000000000   697  Q   W 223490 + 8 [kjournald]"
+ * device, cpu, sequence, seconds, pid, action, rwbs, sector + sectors */
+bool TraceReader::parse_blkparse(const char *line, const char *end, TraceRecord &record)
+{
+	const char *p = line;
+	const char *token, *token_end;
+	double seconds;
+	ulong sector, sectors;
+
+	/* device "major,minor" */
+	if (!next_token(p, end, token, token_end) || memchr(token, ',', token_end - token) == NULL)
+		return false;
+	/* cpu and sequence */
+	if (!next_token(p, end, token, token_end) || !next_token(p, end, token, token_end))
+		return false;
+	if (!parse_double(p, end, seconds))
+		return false;
+	/* pid */
+	if (!next_token(p, end, token, token_end))
+		return false;
+	if (!next_token(p, end, token, token_end) || token_end - token != 1 || *token != 'Q')
+		return false;
+	if (!next_token(p, end, token, token_end))
+		return false;
+	if (memchr(token, 'D', token_end - token) != NULL)
+		record.type = TRIM;
+	else if (memchr(token, 'W', token_end - token) != NULL)
+		record.type = WRITE;
+	else if (memchr(token, 'R', token_end - token) != NULL)
+		record.type = READ;
+	else
+		return false;
+	if (!parse_ulong(p, end, sector))
+		return false;
+	if (!next_token(p, end, token, token_end) || token_end - token != 1 || *token != '+')
+		return false;
+	if (!parse_ulong(p, end, sectors) || sectors == 0)
+		return false;
+
+	set_bytes(record, sector * TRACE_SECTOR_SIZE, sectors * TRACE_SECTOR_SIZE);
+	record.arrive_time = seconds * 1000000.0;
+	return true;
+}
+
+/* pages touched by length bytes at offset */
+void TraceReader::set_bytes(TraceRecord &record, ulong offset, ulong length)
+{
+	assert(length > 0);
+	record.logical_address = offset / PAGE_SIZE;
+	record.size = (offset + length - 1) / PAGE_SIZE - record.logical_address + 1;
+}
+
+/* First byte of the chunk: chunks start at the first line beginning at or
+ * after their nominal offset. */
+ssd::ulong TraceReader::chunk_start(ulong chunk) const
+{
+	if (chunk == 0)
+		return 0;
+	if (chunk >= chunks)
+		return size;
+
+	ulong offset = chunk * TRACE_CHUNK_SIZE - 1;
+	const char *newline = (const char *) memchr(data + offset, '\n', size - offset);
+	return newline == NULL ? size : newline - data + 1;
+}
+
+void TraceReader::parse_chunk(ulong chunk, Slot &slot) const
+{
+	PROFILE_SCOPE(PROFILE_TRACE);
+	const char *line = data + chunk_start(chunk);
+	const char *end = data + chunk_start(chunk + 1);
+
+	slot.records.clear();
+	slot.skipped = 0;
+
+	while (line < end)
+	{
+		const char *line_end = (const char *) memchr(line, '\n', end - line);
+		if (line_end == NULL)
+			line_end = end;
+
+		TraceRecord record;
+		if (parse_line(format, time_base, line, line_end, record))
+			slot.records.push_back(record);
+		else if (skip_space(line, line_end) != line_end)
+			slot.skipped++;
+
+		line = line_end + 1;
+	}
+}
+
+void TraceReader::worker_main(void)
+{
+	for (;;)
+	{
+		ulong chunk = next_chunk.fetch_add(1);
+		if (chunk >= chunks)
+			return;
+
+		/* wait for the reader to hand back the slot */
+		Slot &slot = ring[chunk % ring_size];
+		while (slot.sequence.load(std::memory_order_acquire) != 2 * chunk)
+		{
+			if (stopping.load(std::memory_order_relaxed))
+				return;
+			std::this_thread::yield();
+		}
+
+		parse_chunk(chunk, slot);
+		slot.sequence.store(2 * chunk + 1, std::memory_order_release);
+	}
+}
+
+TraceWriter::TraceWriter(const char *path):
+	file(NULL),
+	records(0),
+	last_time(0)
+{
+	if ((file = fopen(path, "wb")) == NULL)
+	{
+		fprintf(stderr, "TraceWriter error: %s: could not create trace file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	/* the record count is filled in by close */
+	TraceFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TraceReader::BINARY_MAGIC, sizeof(header.magic));
+	header.version = TraceReader::BINARY_VERSION;
+	header.record_size = sizeof(TraceFileRecord);
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+	{
+		fprintf(stderr, "TraceWriter error: %s: could not write to trace file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+}
+
+TraceWriter::~TraceWriter(void)
+{
+	close();
+}
+
+void TraceWriter::write(const TraceRecord &record)
+{
+	assert(file != NULL);
+
+	int64_t time = llround(record.arrive_time * 1000000.0);
+	TraceFileRecord entry;
+	entry.time_delta = time - last_time;
+	entry.logical_address = record.logical_address;
+	entry.size = record.size;
+	entry.type = record.type;
+	entry.reserved = 0;
+	entry.streamID = record.streamID;
+	last_time = time;
+
+	if (fwrite(&entry, sizeof(entry), 1, file) != 1)
+	{
+		fprintf(stderr, "TraceWriter error: %s: could not write to trace file\n", __func__);
+		exit(FILE_ERR);
+	}
+	records++;
+}
+
+void TraceWriter::close(void)
+{
+	if (file == NULL)
+		return;
+
+	uint64_t count = records;
+	if (fseek(file, offsetof(TraceFileHeader, records), SEEK_SET) != 0
+		|| fwrite(&count, sizeof(count), 1, file) != 1 || fclose(file) != 0)
+	{
+		fprintf(stderr, "TraceWriter error: %s: could not finish trace file\n", __func__);
+		exit(FILE_ERR);
+	}
+	file = NULL;
+}
+
+/* Records written so far */
+ssd::ulong TraceWriter::get_records(void) const
+{
+	return records;
+}